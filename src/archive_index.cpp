@@ -0,0 +1,138 @@
+#include "archive_index.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
+const std::string kIndexFileName = "archive.idx";
+constexpr char kSegmentTag = 's';
+constexpr char kEventTag = 'e';
+constexpr size_t kMinStaleLinesToCompact = 1000;
+
+namespace {
+
+int64_t ToSeconds(ArchiveIndex::TimePoint tp) {
+    return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+}
+
+ArchiveIndex::TimePoint FromSeconds(int64_t seconds) {
+    return ArchiveIndex::TimePoint(std::chrono::seconds(seconds));
+}
+
+}  // namespace
+
+ArchiveIndex::ArchiveIndex(std::filesystem::path storage_path)
+    : storage_path_(std::move(storage_path))
+    , index_file_path_(storage_path_ / kIndexFileName) {
+    Load();
+}
+
+void ArchiveIndex::Load() {
+    std::ifstream in(index_file_path_);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream line_stream(line);
+        char tag{};
+        int64_t seconds{};
+        if (!(line_stream >> tag >> seconds))
+            continue;
+
+        if (tag == kSegmentTag) {
+            std::string file_name;
+            if (line_stream >> file_name)
+                segments_[seconds] = std::move(file_name);
+        } else if (tag == kEventTag) {
+            events_.push_back(seconds);
+        }
+    }
+    in.close();
+
+    std::erase_if(segments_, [&](const auto& segment) { return !std::filesystem::exists(storage_path_ / segment.second); });
+    std::sort(begin(events_), end(events_));
+    if (!segments_.empty()) {
+        const auto first_segment_start = segments_.begin()->first;
+        std::erase_if(events_, [&](int64_t event) { return event < first_segment_start; });
+    } else {
+        events_.clear();
+    }
+
+    Save();
+    LOG_INFO << "Archive index loaded, segments = " << segments_.size() << ", events = " << events_.size();
+}
+
+void ArchiveIndex::Save() {
+    index_file_.close();
+    {
+        std::ofstream out(index_file_path_, std::ios::trunc);
+        for (const auto& [start, file_name] : segments_)
+            out << kSegmentTag << ' ' << start << ' ' << file_name << '\n';
+        for (const auto event : events_)
+            out << kEventTag << ' ' << event << '\n';
+    }
+    stale_lines_ = 0;
+
+    index_file_.clear();
+    index_file_.open(index_file_path_, std::ios::app);
+    if (!index_file_)
+        LOG_ERROR_EX << "Unable to open archive index file " << index_file_path_ << ", index is kept in memory only";
+}
+
+void ArchiveIndex::Append(const std::string& line) {
+    if (!index_file_)
+        return;
+    index_file_ << line << '\n';
+    index_file_.flush();
+}
+
+void ArchiveIndex::AddSegment(TimePoint start, const std::string& file_name) {
+    const auto seconds = ToSeconds(start);
+    std::lock_guard lock(mutex_);
+    segments_[seconds] = file_name;
+    Append(kSegmentTag + std::string(" ") + std::to_string(seconds) + " " + file_name);
+}
+
+void ArchiveIndex::AddEvent(TimePoint timestamp) {
+    const auto seconds = ToSeconds(timestamp);
+    std::lock_guard lock(mutex_);
+    events_.insert(std::upper_bound(begin(events_), end(events_), seconds), seconds);
+    Append(kEventTag + std::string(" ") + std::to_string(seconds));
+}
+
+void ArchiveIndex::RemoveSegment(const std::string& file_name) {
+    std::lock_guard lock(mutex_);
+    const auto it = std::find_if(begin(segments_), end(segments_), [&](const auto& segment) { return segment.second == file_name; });
+    if (it == end(segments_))
+        return;
+    segments_.erase(it);
+    ++stale_lines_;
+
+    // Events are kept for the archive which is still available
+    const auto first_kept = segments_.empty() ? end(events_)
+                                              : std::lower_bound(begin(events_), end(events_), segments_.begin()->first);
+    stale_lines_ += static_cast<size_t>(std::distance(begin(events_), first_kept));
+    events_.erase(begin(events_), first_kept);
+
+    // File is rewritten when stale lines outnumber the actual ones, so it's compacted in amortized constant time
+    if (stale_lines_ >= std::max(kMinStaleLinesToCompact, segments_.size() + events_.size()))
+        Save();
+}
+
+std::optional<std::string> ArchiveIndex::FindSegment(TimePoint timestamp) const {
+    std::lock_guard lock(mutex_);
+    auto it = segments_.upper_bound(ToSeconds(timestamp));
+    if (it == segments_.begin())
+        return std::nullopt;
+    return std::prev(it)->second;
+}
+
+std::vector<ArchiveIndex::TimePoint> ArchiveIndex::GetEvents(TimePoint from, TimePoint to) const {
+    std::lock_guard lock(mutex_);
+    const auto first = std::lower_bound(begin(events_), end(events_), ToSeconds(from));
+    const auto last = std::upper_bound(first, end(events_), ToSeconds(to));
+    std::vector<TimePoint> result;
+    result.reserve(static_cast<size_t>(std::distance(first, last)));
+    std::transform(first, last, std::back_inserter(result), FromSeconds);
+    return result;
+}
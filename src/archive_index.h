@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Index of continuous recording segments and detection events. It's kept in memory and appended to a text file,
+// so the segment covering some timestamp is found without scanning storage. Entries of deleted segments are removed,
+// and the file is rewritten when there are too many of them. Thread safe
+class ArchiveIndex final {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    explicit ArchiveIndex(std::filesystem::path storage_path);
+
+    void AddSegment(TimePoint start, const std::string& file_name);
+    void AddEvent(TimePoint timestamp);
+    void RemoveSegment(const std::string& file_name);  // Segment file is deleted, events before the first segment are dropped
+
+    // Returns file name of the segment, started before the timestamp. Segment file might be deleted already
+    std::optional<std::string> FindSegment(TimePoint timestamp) const;
+    std::vector<TimePoint> GetEvents(TimePoint from, TimePoint to) const;
+
+private:
+    void Load();  // Drops entries of deleted segments and rewrites compacted index file
+    void Save();  // Rewrites index file with the current entries
+    void Append(const std::string& line);
+
+    const std::filesystem::path storage_path_;
+    const std::filesystem::path index_file_path_;
+    std::map<int64_t, std::string> segments_;  // Start time (seconds since epoch) -> file name
+    std::vector<int64_t> events_;  // Sorted, seconds since epoch
+    std::ofstream index_file_;
+    size_t stale_lines_{0};  // Lines of removed entries, index file is compacted when there are too many of them
+    mutable std::mutex mutex_;
+};
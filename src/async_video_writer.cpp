@@ -0,0 +1,112 @@
+#include "async_video_writer.h"
+
+#include "log.h"
+#include "metrics.h"
+
+#include <functional>
+
+AsyncVideoWriter::AsyncVideoWriter(const Settings& settings, std::unique_ptr<VideoWriter> writer)
+    : VideoWriter(settings)
+    , writer_(std::move(writer))
+    , max_queue_size_(settings.async_video_writer_settings.max_queue_size)
+    , can_drop_(writer_->NeedsFrames() && !writer_->NeedsPackets())
+    , overflow_strategy_(settings.async_video_writer_settings.overflow_strategy) {
+    uid_ = writer_->GetUid();
+    thread_ = std::jthread(std::bind_front(&AsyncVideoWriter::ThreadFunc, this));
+}
+
+AsyncVideoWriter::~AsyncVideoWriter() {
+    {
+        std::lock_guard lock(mutex_);
+        thread_.request_stop();
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+    writer_.reset();
+    LOG_INFO << "Async video writer finished, uid = " << uid_;
+}
+
+void AsyncVideoWriter::Start() {
+    writer_->Start();
+}
+
+void AsyncVideoWriter::Stop() {
+    writer_->Stop();
+}
+
+void AsyncVideoWriter::AddFrame(cv::Mat frame) {
+    Enqueue(std::move(frame));
+}
+
+void AsyncVideoWriter::AddPacket(const EncodedPacket& packet) {
+    Enqueue(packet);
+}
+
+bool AsyncVideoWriter::NeedsFrames() const {
+    return writer_->NeedsFrames();
+}
+
+bool AsyncVideoWriter::NeedsPackets() const {
+    return writer_->NeedsPackets();
+}
+
+bool AsyncVideoWriter::SetPartFinishedCallback(PartFinishedCallback callback) {
+    std::lock_guard lock(mutex_);
+    return writer_->SetPartFinishedCallback(std::move(callback));
+}
+
+std::string AsyncVideoWriter::GetUid() const {
+    return uid_;
+}
+
+cv::Mat AsyncVideoWriter::GetPreviewImage() const {
+    std::unique_lock lock(mutex_);
+    cv_.wait(lock, [&] { return queue_.empty() && !busy_; });
+    return writer_->GetPreviewImage();
+}
+
+void AsyncVideoWriter::Enqueue(Item item) {
+    std::unique_lock lock(mutex_);
+    if (queue_.size() >= max_queue_size_) {
+        if (can_drop_ && overflow_strategy_ == BufferOverflowStrategy::kDropHalf) {
+            LOG_WARNING << "Video writer queue size exceeds max (" << max_queue_size_ << "), dropping half of queue";
+            const size_t half = queue_.size() / 2;
+            queue_.erase(begin(queue_), begin(queue_) + static_cast<decltype(queue_)::difference_type>(half));
+            AppMetrics->Add("video_writer_dropped_frames", static_cast<double>(half));
+        } else {
+            LOG_WARNING << "Video writer queue size exceeds max (" << max_queue_size_ << "), waiting";
+            AppMetrics->Add("video_writer_delays");
+            cv_.wait(lock, [&] { return queue_.size() < max_queue_size_; });
+        }
+    }
+    queue_.push_back(std::move(item));
+    lock.unlock();
+    cv_.notify_all();
+}
+
+void AsyncVideoWriter::ThreadFunc(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [&] { return !queue_.empty() || stop_token.stop_requested(); });
+        if (queue_.empty())  // Stop is requested, and everything is written
+            break;
+
+        auto item = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true;
+        lock.unlock();
+        cv_.notify_all();
+
+        if (auto* frame = std::get_if<cv::Mat>(&item)) {
+            writer_->AddFrame(std::move(*frame));
+        } else {
+            writer_->AddPacket(std::get<EncodedPacket>(item));
+        }
+
+        lock.lock();
+        busy_ = false;
+        lock.unlock();
+        cv_.notify_all();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "encoded_packet.h"
+#include "settings.h"
+#include "video_writer.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <variant>
+
+// Runs wrapped writer in its own thread with bounded queue, so encoding and file operations don't block the caller.
+// Destructor writes all queued items and closes the wrapped writer, so it might take a while
+class AsyncVideoWriter final : public VideoWriter {
+public:
+    AsyncVideoWriter(const Settings& settings, std::unique_ptr<VideoWriter> writer);
+    ~AsyncVideoWriter();
+
+    AsyncVideoWriter(const AsyncVideoWriter&) = delete;
+    AsyncVideoWriter(AsyncVideoWriter&&) = delete;
+    AsyncVideoWriter& operator=(const AsyncVideoWriter&) = delete;
+    AsyncVideoWriter& operator=(AsyncVideoWriter&&) = delete;
+
+    void Start() override;
+    void Stop() override;
+    void AddFrame(cv::Mat frame) override;
+    void AddPacket(const EncodedPacket& packet) override;
+
+    bool NeedsFrames() const override;
+    bool NeedsPackets() const override;
+    bool SetPartFinishedCallback(PartFinishedCallback callback) override;  // Callback is called from writer thread
+
+    std::string GetUid() const override;
+    cv::Mat GetPreviewImage() const override;  // Waits until queued items are written
+
+private:
+    using Item = std::variant<cv::Mat, EncodedPacket>;
+
+    void Enqueue(Item item);
+    void ThreadFunc(std::stop_token stop_token);
+
+    std::unique_ptr<VideoWriter> writer_;
+    const size_t max_queue_size_;
+    // Dropping compressed packets breaks the video, so frames are dropped only for writers which encode them
+    const bool can_drop_;
+    const BufferOverflowStrategy overflow_strategy_;
+
+    std::deque<Item> queue_;
+    bool busy_{false};  // Item is being written
+    mutable std::mutex mutex_;
+    mutable std::condition_variable cv_;
+    std::jthread thread_;
+};
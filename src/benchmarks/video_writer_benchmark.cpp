@@ -0,0 +1,101 @@
+// Encodes fixed synthetic clip with every encoding writer available in the build, and prints encode fps and bytes per
+// minute. Writer options (codec, container, libav encoder settings) are taken from the settings file, if specified
+
+#include "log.h"
+#include "metrics.h"
+#include "opencv_video_writer.h"
+#include "ring_buffer.h"
+#include "safe_ptr.h"
+#include "settings.h"
+#include "stream_properties.h"
+#include "video_writer.h"
+
+#ifdef USE_LIBAV
+#include "libav_video_writer.h"
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+
+LogLevel kAppLogLevel{LogLevel::kWarning};
+std::ostream* kAppLogStream{&std::cout};
+SafePtr<RingBuffer<std::string>> AppLogTail{32};
+SafePtr<Metrics> AppMetrics{};
+
+namespace {
+
+const StreamProperties kClipProperties{25.0, 720, 1280};
+const int kClipFrames = 250;  // 10 seconds
+
+// Moving objects over noisy gradient, the same for every run
+cv::Mat MakeFrame(int frame_number) {
+    static const cv::Mat background = [] {
+        cv::Mat gradient(kClipProperties.height, kClipProperties.width, CV_8UC3);
+        for (int y = 0; y < gradient.rows; ++y) {
+            const auto value = y * 255 / gradient.rows;
+            gradient.row(y).setTo(cv::Scalar(value, 128, 255 - value));
+        }
+        return gradient;
+    }();
+
+    cv::Mat frame = background.clone();
+    cv::rectangle(frame, cv::Rect(frame_number * 4 % frame.cols, frame.rows / 3, 160, 120), cv::Scalar(0, 0, 255), cv::FILLED);
+    cv::circle(frame, cv::Point(frame.cols - frame_number * 3 % frame.cols, frame.rows * 2 / 3), 60, cv::Scalar(255, 255, 255), cv::FILLED);
+
+    cv::Mat noise(frame.size(), frame.type());
+    cv::RNG rng(static_cast<uint64_t>(frame_number) + 1);
+    rng.fill(noise, cv::RNG::UNIFORM, 0, 16);
+    return frame + noise;
+}
+
+void Run(const std::string& writer_name, const std::function<std::unique_ptr<VideoWriter>()>& create_writer) {
+    {
+        const auto writer = create_writer();
+        for (int i = 0; i < kClipFrames; ++i)
+            writer->AddFrame(MakeFrame(i));
+    }  // Stats are reported when the file is closed
+
+    std::cout << writer_name << ": encode fps = " << AppMetrics->Get("video_writer_encode_fps_" + writer_name)
+              << ", bytes per minute = " << AppMetrics->Get("video_writer_bytes_per_min_" + writer_name) << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    if (argc > 1) {
+        try {
+            settings = LoadSettings(argv[1]);
+        } catch (const std::exception& e) {
+            std::cout << "Error loading config file: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    VideoWriter::kVideoCodec = settings.video_codec;
+    VideoWriter::kVideoFileExtension = "." + settings.video_container;
+    settings.storage_path = std::filesystem::temp_directory_path() / "video_writer_benchmark";
+    settings.max_video_part_size_bytes = 0;
+    settings.max_video_part_duration = std::chrono::milliseconds(0);
+    settings.early_video_part_duration = std::chrono::milliseconds(0);
+    std::filesystem::remove_all(settings.storage_path);
+    std::filesystem::create_directories(settings.storage_path);
+
+    std::cout << "Clip: " << kClipProperties.width << "x" << kClipProperties.height << ", " << kClipFrames << " frames" << std::endl;
+    try {
+        Run("opencv", [&] { return std::make_unique<OpenCvVideoWriter>(settings, kClipProperties, kClipProperties); });
+#ifdef USE_LIBAV
+        Run("libav", [&] { return std::make_unique<LibavVideoWriter>(settings, kClipProperties); });
+#endif
+    } catch (const std::exception& e) {
+        std::cout << "Benchmark failed: " << e.what() << std::endl;
+    }
+
+    std::filesystem::remove_all(settings.storage_path);
+    return 0;
+}
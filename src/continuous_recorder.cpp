@@ -0,0 +1,114 @@
+#include "continuous_recorder.h"
+
+#include "log.h"
+#include "metrics.h"
+#include "passthrough_video_writer.h"
+
+#include <functional>
+
+namespace {
+
+Settings GetSegmentSettings(const Settings& settings) {
+    auto segment_settings = settings;
+    segment_settings.early_video_part_duration = std::chrono::milliseconds(0);  // Segments are not sent progressively
+    return segment_settings;
+}
+
+}  // namespace
+
+ContinuousRecorder::ContinuousRecorder(const Settings& settings, std::shared_ptr<ArchiveIndex> archive_index, StorageRetention* storage_retention)
+    : settings_(GetSegmentSettings(settings))
+    , segment_duration_(settings.continuous_recording_settings.segment_duration)
+    , max_queue_size_(settings.continuous_recording_settings.max_queue_size)
+    , archive_index_(std::move(archive_index))
+    , storage_retention_(storage_retention) {
+    thread_ = std::jthread(std::bind_front(&ContinuousRecorder::ThreadFunc, this));
+    LOG_INFO << "Continuous recording started, segment duration = " << segment_duration_.count() << " ms";
+}
+
+ContinuousRecorder::~ContinuousRecorder() {
+    {
+        std::lock_guard lock(mutex_);
+        thread_.request_stop();
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+    FinishSegment();
+    LOG_INFO << "Continuous recording finished";
+}
+
+void ContinuousRecorder::AddPacket(EncodedPacket packet) {
+    {
+        std::lock_guard lock(mutex_);
+        bool restart_segment = false;
+        if (skip_till_keyframe_) {
+            if (!packet.key_frame) {
+                AppMetrics->Add("continuous_recording_dropped_packets");
+                return;
+            }
+            skip_till_keyframe_ = false;
+            restart_segment = true;
+        } else if (queue_.size() >= max_queue_size_) {
+            // Dropping compressed packets breaks the video till the next keyframe, so the rest of GOP is dropped too
+            LOG_WARNING << "Continuous recording queue size exceeds max (" << max_queue_size_ << "), dropping packets till keyframe";
+            skip_till_keyframe_ = true;
+            AppMetrics->Add("continuous_recording_dropped_packets");
+            return;
+        }
+        queue_.push_back(Item{std::move(packet), restart_segment});
+    }
+    cv_.notify_all();
+}
+
+void ContinuousRecorder::ThreadFunc(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [&] { return !queue_.empty() || stop_token.stop_requested(); });
+        if (queue_.empty())  // Stop is requested, and everything is written
+            break;
+
+        auto item = std::move(queue_.front());
+        queue_.pop_front();
+        lock.unlock();
+
+        WritePacket(item.packet, item.restart_segment);
+    }
+}
+
+void ContinuousRecorder::WritePacket(const EncodedPacket& packet, bool restart_segment) {
+    if (packet.key_frame) {
+        // Stream parameters are changed on reconnect, packets can't be written into the same file
+        if (!writer_ || restart_segment || packet.stream != stream_info_
+            || std::chrono::steady_clock::now() - segment_start_ >= segment_duration_) {
+            StartSegment();
+            stream_info_ = packet.stream;
+        }
+    }
+
+    if (writer_)
+        writer_->AddPacket(packet);
+}
+
+void ContinuousRecorder::FinishSegment() {
+    if (!writer_)
+        return;
+    const auto uid = writer_->GetUid();
+    writer_->SetPartFinishedCallback({});  // No part follows the last one
+    writer_.reset();  // File is closed here
+    if (storage_retention_)
+        storage_retention_->AddVideo(uid, kFilePrefix);
+}
+
+void ContinuousRecorder::StartSegment() {
+    FinishSegment();
+    writer_ = std::make_unique<PassthroughVideoWriter>(settings_, kFilePrefix);
+    segment_start_ = std::chrono::steady_clock::now();
+    archive_index_->AddSegment(std::chrono::system_clock::now(), VideoWriter::GenerateVideoFileName(writer_->GetUid(), kFilePrefix));
+
+    // Next part is started right after the previous one is closed, so the part covering a timestamp is found as well
+    writer_->SetPartFinishedCallback([this, uid = writer_->GetUid()](const std::filesystem::path& /*file_path*/, size_t part_number) {
+        archive_index_->AddSegment(std::chrono::system_clock::now(), VideoWriter::GeneratePartFileName(uid, part_number + 1, kFilePrefix));
+    });
+    AppMetrics->Add("continuous_recording_segments");
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "archive_index.h"
+#include "encoded_packet.h"
+#include "settings.h"
+#include "storage_retention.h"
+#include "video_writer.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Records the source stream 24/7 into fixed length segments by remuxing compressed packets, so no extra decoding is
+// needed. Segments start from keyframe and are registered in archive index, as well as every part of a segment split by
+// size limit. Packets are written in own thread
+class ContinuousRecorder final {
+public:
+    // Storage retention is optional, finished segments are registered in it
+    ContinuousRecorder(const Settings& settings, std::shared_ptr<ArchiveIndex> archive_index, StorageRetention* storage_retention);
+    ~ContinuousRecorder();
+
+    ContinuousRecorder(const ContinuousRecorder&) = delete;
+    ContinuousRecorder(ContinuousRecorder&&) = delete;
+    ContinuousRecorder& operator=(const ContinuousRecorder&) = delete;
+    ContinuousRecorder& operator=(ContinuousRecorder&&) = delete;
+
+    void AddPacket(EncodedPacket packet);  // Doesn't block, packets are dropped if writing can't keep up
+
+    inline static const std::string kFilePrefix{"c_"};
+
+private:
+    struct Item {
+        EncodedPacket packet;
+        bool restart_segment{false};  // Some packets are dropped before this one
+    };
+
+    void ThreadFunc(std::stop_token stop_token);
+    void WritePacket(const EncodedPacket& packet, bool restart_segment);
+    void StartSegment();
+    void FinishSegment();
+
+    const Settings settings_;
+    const std::chrono::milliseconds segment_duration_;
+    const size_t max_queue_size_;
+    std::shared_ptr<ArchiveIndex> archive_index_;
+    StorageRetention* const storage_retention_;
+
+    // Accessed from writing thread only
+    std::unique_ptr<VideoWriter> writer_;
+    std::shared_ptr<const EncodedStreamInfo> stream_info_;
+    std::chrono::time_point<std::chrono::steady_clock> segment_start_{};
+
+    std::deque<Item> queue_;
+    bool skip_till_keyframe_{false};  // Queue overflowed, segment is restarted from the next keyframe
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::jthread thread_;
+};
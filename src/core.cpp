@@ -1,57 +1,298 @@
 #include "core.h"
 
 #include "ai_factory.h"
+#include "frame_reader_factory.h"
 #include "log.h"
+#include "metrics.h"
 #include "translation.h"
 #include "uid_utils.h"
 #include "video_writer_factory.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
 constexpr auto kBufferOverflowDelay = std::chrono::seconds(1);
 constexpr auto kDecreasedCheckFrameInterval = std::chrono::milliseconds(1000);
+constexpr auto kMaxSnapshotAge = std::chrono::milliseconds(1000);  // Older frame is not used for on-demand photo
+// Frames decoded after single-stream detect frame, while it waits for detect. Recording started by it continues with
+// them, instead of skipping frames grabbed before it's started. Bounded, as most of detect frames don't start recording
+constexpr uint64_t kDetectLookAheadFrames = 3;
+constexpr int kMaxPreEventFrameWidth = 1280;  // Pre-event frames are encoded on processing thread, so big ones are downscaled
+
+namespace {
+
+std::vector<Detection> ScaleDetections(const std::vector<Detection>& detections, const cv::Size& from, const cv::Size& to) {
+    const double scale_x = to.width / static_cast<double>(from.width);
+    const double scale_y = to.height / static_cast<double>(from.height);
+    std::vector<Detection> result = detections;
+    for (auto& detection : result) {
+        auto& box = detection.box;
+        box = cv::Rect(cv::Point(static_cast<int>(box.x * scale_x), static_cast<int>(box.y * scale_y)),
+                       cv::Point(static_cast<int>(box.br().x * scale_x), static_cast<int>(box.br().y * scale_y)));
+    }
+    return result;
+}
+
+}  // namespace
 
 Core::Core(Settings settings)
     : settings_(std::move(settings))
-    , frame_reader_(settings_.source)
-    , bot_(settings_.bot_token, settings_.storage_path, settings_.allowed_users, settings_.admin_users)
+    , frame_reader_(FrameReaderFactory(settings_, settings_.source))
+    , qos_(settings_)
+    , static_scene_filter_(settings_.static_scene_settings)
+    , use_pre_event_packets_(settings_.pre_event_settings.duration.count() > 0 && settings_.video_writer == VideoWriterType::kPassthrough)
+    , use_pre_event_frames_(settings_.pre_event_settings.duration.count() > 0 && settings_.detect_source.empty()
+                            && (settings_.video_writer == VideoWriterType::kOpenCv || settings_.video_writer == VideoWriterType::kLibav))
+    , pre_event_packets_(settings_.pre_event_settings.duration, settings_.pre_event_settings.max_size_bytes)
+    , pre_event_frames_(settings_.pre_event_settings.duration, settings_.pre_event_settings.max_size_bytes)
+    , recordings_index_(std::make_shared<RecordingsIndex>(settings_.storage_path))
+    , bot_(settings_.bot_token, settings_.telegram_api_url, settings_.storage_path, settings_.allowed_users, settings_.admin_users, recordings_index_, settings_.send_workers,
+           settings_.telegram_rate_limit_settings, settings_.media_group_window, settings_.command_workers)
     , ai_error_(&bot_, translation::errors::kAiProcessingError, translation::errors::kAiProcessingRestored)
-    , frame_reader_error_(&bot_, translation::errors::kGetFrameError, translation::errors::kGetFrameRestored) {
+    , frame_reader_error_(&bot_, translation::errors::kGetFrameError, translation::errors::kGetFrameRestored)
+    , detect_frame_reader_error_(&bot_, translation::errors::kDetectFrameError, translation::errors::kDetectFrameRestored) {
 
     ai_ = AiFactory(settings_.detection_engine, settings_);
     VideoWriter::kVideoCodec = settings_.video_codec;
     VideoWriter::kVideoFileExtension = "." + settings_.video_container;
 
+    if (settings_.storage_retention_settings.enabled) {
+        storage_retention_ = std::make_unique<StorageRetention>(settings_, &bot_);
+        // Video is removed from index along with its main file, continuous recording segments are removed one by one
+        storage_retention_->SetFileDeletedCallback([this](const std::filesystem::path& file_path, StoredFileType type) {
+            if (type == StoredFileType::kVideo && VideoWriter::IsVideoFile(file_path))
+                recordings_index_->Remove(GetUidFromFileName(file_path.filename().generic_string()));
+            else if (type == StoredFileType::kContinuous && archive_index_)  // Index is created later, but before retention is started
+                archive_index_->RemoveSegment(file_path.filename().generic_string());
+        });
+    }
+
+    if (settings_.continuous_recording_settings.enabled) {
+#ifdef USE_LIBAV
+        archive_index_ = std::make_shared<ArchiveIndex>(settings_.storage_path);
+        continuous_recorder_ = std::make_unique<ContinuousRecorder>(settings_, archive_index_, storage_retention_.get());
+        bot_.SetArchiveIndex(archive_index_);
+#else
+        static const auto err_msg = "Continuous recording requested, but application is built without libav support";
+        LOG_ERROR_EX << err_msg;
+        throw std::runtime_error(err_msg);
+#endif
+    }
+
+    if (settings_.video_writer == VideoWriterType::kPassthrough || continuous_recorder_) {
+        const auto packet_handler = [this](EncodedPacket packet) {
+            if (continuous_recorder_)
+                continuous_recorder_->AddPacket(packet);
+
+            if (recording_packets_.load()) {
+                if (!pre_event_packets_.Empty()) {
+                    LOG_INFO << "Flush pre-event packets, size = " << pre_event_packets_.SizeBytes();
+                    AppMetrics->Set("pre_event_packets_bytes", static_cast<double>(pre_event_packets_.SizeBytes()));
+                    for (auto& entry : pre_event_packets_.Take())
+                        pending_packets_.push_back(std::move(entry.item));
+                }
+                pending_packets_.push_back(std::move(packet));
+            } else if (use_pre_event_packets_) {
+                const auto size_bytes = packet.size_bytes;
+                const auto key_frame = packet.key_frame;
+                pre_event_packets_.Push(std::move(packet), size_bytes, key_frame);
+            }
+        };
+        if (!frame_reader_->SetPacketHandler(packet_handler)) {
+            static const auto err_msg = "Passthrough video writer and continuous recording require frame reader with packets access (libav reader)";
+            LOG_ERROR_EX << err_msg;
+            throw std::runtime_error(err_msg);
+        }
+    }
+
+    if (settings_.pre_event_settings.duration.count() > 0 && !use_pre_event_packets_ && !use_pre_event_frames_)
+        LOG_WARNING << "Pre-event buffer is not supported with selected video writer and source, it is disabled";
+
     bot_.Start();
-    frame_reader_.Open();
+    frame_reader_->Open();
+    if (!settings_.detect_source.empty()) {
+        LOG_INFO << "Dual-stream mode, detect source: " << settings_.detect_source;
+        detect_frame_reader_ = FrameReaderFactory(settings_, settings_.detect_source);
+        detect_frame_reader_->Open();
+    }
 
     if (settings_.notify_on_start)
         bot_.PostTextMessage(translation::messages::kAppStarted);
 }
 
 Core::~Core() {
-    bot_.Stop();
+    // Bot is stopped last, so videos and photos finalized on stop are posted. Whatever is not sent is kept for resending
     Stop();
+    bot_.Stop();
 }
 
-void Core::PostOnDemandPhoto(const cv::Mat& frame) {
+bool Core::PostOnDemandPhoto() {
+    // Photo doesn't wait for processing of buffered frames, so its latency doesn't depend on detect load
+    const auto snapshot = snapshot_slot_.Get();
+    if (!snapshot)
+        return false;
+    const auto age = std::chrono::steady_clock::now() - snapshot->timestamp;
+    if (age > kMaxSnapshotAge)
+        return false;
+
+    // Waiting users are taken right away, so the photo is not requested again for the next frames
+    auto recipients = bot_.TakeUsersWaitingForPhoto();
+    if (recipients.empty())
+        return true;
+    AppMetrics->Set("on_demand_photo_frame_age_ms", static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(age).count()));
     const auto file_name = GenerateFileName("on_demand_") + ".jpg";
-    const auto path = (settings_.storage_path / file_name).generic_string();
-    if (!cv::imwrite(path, frame))
-        LOG_ERROR_EX << "Error write on-demand photo, " << LOG_VAR(path);
-    bot_.PostOnDemandPhoto(path);
+    QueuePhoto(PendingPhoto{snapshot->image, settings_.storage_path / file_name, false, {}, std::move(recipients)});
+    return true;
+}
+
+void Core::QueuePhoto(PendingPhoto photo) {
+    {
+        std::lock_guard lock(photo_mutex_);
+        if (photo_queue_.size() >= settings_.photo_settings.max_queue_size) {
+            LOG_WARNING << "Photo queue size exceeds max (" << settings_.photo_settings.max_queue_size << "), photo dropped: " << photo.file_path;
+            AppMetrics->Add("dropped_photos");
+            return;
+        }
+        photo_queue_.push_back(std::move(photo));
+    }
+    photo_cv_.notify_all();
+}
+
+void Core::EncodePhoto(PendingPhoto photo) {
+    const auto encode_start = std::chrono::steady_clock::now();
+    const std::vector<int> img_encode_param{cv::IMWRITE_JPEG_QUALITY, settings_.photo_settings.jpeg_quality};
+    auto encoded = std::make_shared<std::vector<uchar>>();
+    if (!cv::imencode(".jpg", photo.frame, *encoded, img_encode_param)) {
+        LOG_ERROR_EX << "Unable to encode photo, " << LOG_VAR(photo.file_path);
+        return;
+    }
+    AppMetrics->Set("photo_encode_ms", static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - encode_start).count()));
+
+    // Photo is sent from memory, so it's posted before it's written
+    const telegram::messages::ImageData image = encoded;
+    if (photo.alarm) {
+        bot_.PostAlarmPhoto(photo.file_path, photo.classes_detected, image);
+    } else {
+        bot_.PostOnDemandPhoto(std::move(photo.recipients), photo.file_path, image);
+    }
+
+    if (!settings_.photo_settings.save_to_disk)
+        return;
+    std::ofstream out(photo.file_path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(encoded->data()), static_cast<std::streamsize>(encoded->size()));
+    out.close();
+    if (!out)
+        LOG_ERROR_EX << "Error write photo, " << LOG_VAR(photo.file_path);
+    else if (storage_retention_)
+        storage_retention_->AddFile(photo.file_path);
+}
+
+void Core::PhotoThreadFunc(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(photo_mutex_);
+        photo_cv_.wait(lock, [&] { return !photo_queue_.empty() || stop_token.stop_requested(); });
+        if (photo_queue_.empty())  // Stop is requested, and all photos are posted
+            break;
+
+        auto photo = std::move(photo_queue_.front());
+        photo_queue_.pop_front();
+        lock.unlock();
+        EncodePhoto(std::move(photo));
+    }
 }
 
 void Core::InitVideoWriter() {
     LOG_INFO << "Init video writer";
-    const auto in_properties = frame_reader_.GetStreamProperties();
+    if (archive_index_)
+        archive_index_->AddEvent(std::chrono::system_clock::now());
+    recording_start_ = std::chrono::steady_clock::now();
+    recording_classes_.clear();
+    const auto in_properties = frame_reader_->GetStreamProperties();
     const auto out_properties = StreamProperties{
         in_properties.fps,
         settings_.use_video_scale ? settings_.video_height : in_properties.height,
         settings_.use_video_scale ? settings_.video_width : in_properties.width};
     video_writer_ = VideoWriterFactory(settings_, in_properties, out_properties);
+    if (settings_.send_video && settings_.send_video_progressively) {
+        video_parts_posted_.store(video_writer_->SetPartFinishedCallback([this](const std::filesystem::path& file_path, size_t part_number) {
+            bot_.PostVideoPart(file_path, part_number);
+        }));
+        if (!video_parts_posted_.load())
+            LOG_WARNING << "Video writer doesn't support progressive sending, video will be sent after recording";
+    }
     video_writer_->Start();
+    if (use_pre_event_frames_)
+        WritePreEventFrames();
+    recording_.store(video_writer_->NeedsFrames());
+    recording_packets_.store(video_writer_->NeedsPackets());
 }
 
-void Core::PostAlarmPhoto(const cv::Mat& frame, const std::vector<Detection>& detections) {
+void Core::StorePreEventFrame(const cv::Mat& frame) {
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_pre_event_frame_ < settings_.pre_event_settings.frames_interval)
+        return;
+    last_pre_event_frame_ = now;
+
+    // Frame is not kept in size bigger than the video, and it's scaled back to stream size when written
+    const auto max_width = settings_.use_video_scale ? std::min(settings_.video_width, kMaxPreEventFrameWidth) : kMaxPreEventFrameWidth;
+    cv::Mat scaled_frame;
+    if (frame.cols > max_width) {
+        const double scale = max_width / static_cast<double>(frame.cols);
+        cv::resize(frame, scaled_frame, cv::Size(0, 0), scale, scale, cv::INTER_AREA);
+    }
+
+    const std::vector<int> img_encode_param{cv::IMWRITE_JPEG_QUALITY, settings_.pre_event_settings.jpeg_quality};
+    std::vector<uchar> encoded;
+    if (!cv::imencode(".jpg", scaled_frame.empty() ? frame : scaled_frame, encoded, img_encode_param)) {
+        LOG_ERROR_EX << "Unable to encode pre-event frame";
+        return;
+    }
+    const auto size_bytes = encoded.size();
+    pre_event_frames_.Push(std::move(encoded), size_bytes, true, now);
+}
+
+void Core::WritePreEventFrames() {
+    if (pre_event_frames_.Empty())
+        return;
+
+    LOG_INFO << "Write pre-event frames, size = " << pre_event_frames_.SizeBytes();
+    AppMetrics->Set("pre_event_frames_bytes", static_cast<double>(pre_event_frames_.SizeBytes()));
+    // Only some frames are kept, so each one is repeated to fill the time until the next one
+    const auto stream_properties = frame_reader_->GetStreamProperties();
+    const auto fps = stream_properties.fps;
+    const cv::Size frame_size(stream_properties.width, stream_properties.height);
+    const auto entries = pre_event_frames_.Take();
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        cv::Mat frame = cv::imdecode(entries[i].item, cv::IMREAD_COLOR);
+        if (frame.empty()) {
+            LOG_ERROR_EX << "Unable to decode pre-event frame";
+            continue;
+        }
+        if (frame.size() != frame_size && !frame_size.empty())  // Downscaled when stored
+            cv::resize(frame, frame, frame_size, 0.0, 0.0, cv::INTER_LINEAR);
+        const auto next_timestamp = i + 1 < entries.size() ? entries[i + 1].timestamp : now;
+        const std::chrono::duration<double> interval = next_timestamp - entries[i].timestamp;
+        const auto repeat = std::max(1, static_cast<int>(std::lround(interval.count() * fps)));
+        for (int r = 0; r < repeat; ++r)
+            video_writer_->AddFrame(frame);
+    }
+}
+
+void Core::AddVideoFrame(cv::Mat frame, const cv::Mat& detect_source_frame) {
+    if (video_writer_->NeedsFrames()) {
+        if (!frame.empty())
+            video_writer_->AddFrame(std::move(frame));
+    } else {
+        // Frame is used for preview only. Detect source frames are always available and have the same size
+        video_writer_->AddFrame(detect_source_frame);
+    }
+}
+
+void Core::PostAlarmPhoto(cv::Mat frame, const std::vector<Detection>& detections) {
     last_alarm_photo_sent_ = std::chrono::steady_clock::now();
 
     std::string classes_detected;
@@ -62,13 +303,9 @@ void Core::PostAlarmPhoto(const cv::Mat& frame, const std::vector<Detection>& de
         classes_detected.erase(classes_detected.size() - 2, 2);  // last ", "
     }
 
-
     const auto file_name = GenerateFileName("alarm_") + ".jpg";
-    const auto path = settings_.storage_path / file_name;
-    if (!cv::imwrite(path.generic_string(), frame))
-        LOG_ERROR_EX << "Error write alarm photo, " << LOG_VAR(path);
-    bot_.PostAlarmPhoto(path, classes_detected);
-} 
+    QueuePhoto(PendingPhoto{std::move(frame), settings_.storage_path / file_name, true, std::move(classes_detected), {}});
+}
 
 void Core::DrawBoxes(const cv::Mat& frame, const std::vector<Detection>& detections) {
     static const cv::Scalar frame_color = {settings_.frame_color.R, settings_.frame_color.G, settings_.frame_color.B};
@@ -77,12 +314,14 @@ void Core::DrawBoxes(const cv::Mat& frame, const std::vector<Detection>& detecti
     }
 }
 
-std::filesystem::path Core::SaveVideoPreview(const std::string& video_file_uid) {
-    const auto file_name = VideoWriter::GeneratePreviewFileName(video_file_uid);
+std::filesystem::path Core::SaveVideoPreview(const VideoWriter& video_writer) {
+    const auto file_name = VideoWriter::GeneratePreviewFileName(video_writer.GetUid());
     const std::vector<int> img_encode_param{cv::IMWRITE_JPEG_QUALITY, 90};
     auto path = settings_.storage_path / file_name;
-    if (!cv::imwrite(path.generic_string(), video_writer_->GetPreviewImage(), img_encode_param))
+    if (!cv::imwrite(path.generic_string(), video_writer.GetPreviewImage(), img_encode_param))
         LOG_ERROR_EX << "Error write video preview image, " << LOG_VAR(path);
+    else if (storage_retention_)
+        storage_retention_->AddFile(path);
     return path;
 }
 
@@ -96,13 +335,12 @@ void Core::PostVideo(const std::string& uid) {
 }
 
 void Core::ProcessingThreadFunc(std::stop_token stop_token) {
-    const auto scaled_size = cv::Size(
-        static_cast<int>(frame_reader_.GetStreamProperties().width * settings_.img_scale_x),
-        static_cast<int>(frame_reader_.GetStreamProperties().height * settings_.img_scale_y));
     const auto img_format = "." + settings_.img_format;
 
     cv::Mat frame{};
+    cv::Mat detect_source_frame{};
     cv::Mat scaled_frame{};
+    std::vector<EncodedPacket> packets;
     while (!stop_token.stop_requested()) [[unlikely]] {
         std::unique_lock lock(buffer_mutex_);
         buffer_cv_.wait(lock, [&] { return !buffer_.empty() || stop_token.stop_requested(); });
@@ -110,16 +348,21 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
         if (stop_token.stop_requested())
             break;
 
-        frame = std::move(buffer_.front());
+        frame = std::move(buffer_.front().frame);
+        detect_source_frame = std::move(buffer_.front().detect_frame);
+        bool check_frame = buffer_.front().detect;
+        packets = std::move(buffer_.front().packets);
         buffer_.pop_front();
-        //cv::Mat frame = buffer_.front();
+        const size_t buffer_size = buffer_.size();
         lock.unlock();
 
-        if (bot_.SomeoneIsWaitingForPhoto())
-            PostOnDemandPhoto(frame);
+        if (video_writer_) {
+            for (const auto& packet : packets)
+                video_writer_->AddPacket(packet);
+        }
 
-        static uint64_t i = 0;
-        bool check_frame = (i++ % settings_.nth_detect_frame == 0);
+        // In dual-stream mode main stream frame is present only while recording or taking a photo
+        const bool has_frame = !frame.empty();
 
         // Check if decreased check rate is used and alter check_frame if needed
         if (check_frame && video_writer_
@@ -130,7 +373,7 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
         }
 
         if (!check_frame) {
-            if (video_writer_) {
+            if (video_writer_ && has_frame && video_writer_->NeedsFrames()) {
                 LOG_TRACE << "Detect not called, just write";
                 video_writer_->AddFrame(frame);
             }
@@ -139,11 +382,36 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
         if (check_frame) {
             last_checked_frame_ = std::chrono::steady_clock::now();
 
-            if (settings_.use_image_scale)
-                cv::resize(frame, scaled_frame, scaled_size, cv::INTER_AREA);  // TODO: Check performance
+            // Detect source is the sub-stream frame in dual-stream mode, and the main frame otherwise.
+            // Image scale is not applied to sub-stream - it is expected to be small enough
+            const bool dual_stream = !detect_source_frame.empty();
+            if (!dual_stream)
+                detect_source_frame = frame;
+
+            const double qos_scale = qos_.GetScale();
+            const bool use_img_scale = settings_.use_image_scale && !dual_stream;
+            const bool use_scale = use_img_scale || qos_scale < 1.0;
+            if (use_scale) {
+                const auto scale_x = (use_img_scale ? settings_.img_scale_x : 1.0) * qos_scale;
+                const auto scale_y = (use_img_scale ? settings_.img_scale_y : 1.0) * qos_scale;
+                const auto scaled_size = cv::Size(
+                    static_cast<int>(detect_source_frame.cols * scale_x),
+                    static_cast<int>(detect_source_frame.rows * scale_y));
+                cv::resize(detect_source_frame, scaled_frame, scaled_size, cv::INTER_AREA);  // TODO: Check performance
+            }
 
+            const auto& detect_frame = use_scale ? scaled_frame : detect_source_frame;
             std::vector<Detection> detections;
-            const auto detect_result = ai_->Detect(settings_.use_image_scale ? scaled_frame : frame, detections);
+            bool detect_result = true;
+            if (static_scene_filter_.CanSkip(detect_frame)) {
+                LOG_TRACE << "Scene is static, detect skipped";
+            } else {
+                const auto detect_start = std::chrono::steady_clock::now();
+                detect_result = ai_->Detect(detect_frame, detections);
+                const auto detect_latency = std::chrono::steady_clock::now() - detect_start;
+                qos_.OnDetect(detect_latency, buffer_size);
+                static_scene_filter_.OnDetect(detect_result && detections.empty(), detect_latency);
+            }
             LOG_TRACE << "Detect result: " << detect_result;
             ai_error_.Update(detect_result ? ErrorReporter::ErrorState::kNoError : ErrorReporter::ErrorState::kError);
 
@@ -156,17 +424,37 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
                 if (!video_writer_)
                     InitVideoWriter();
 
-                video_writer_->AddFrame(frame);
+                AddVideoFrame(frame, detect_source_frame);
+                for (const auto& detection : detections)
+                    recording_classes_.insert(detection.class_name);
                 const auto video_uid = video_writer_->GetUid();
                 if (video_uid != last_alarm_video_uid_ || IsAlarmImageDelayPassed()) {
-                    auto& alarm_frame = settings_.use_image_scale ? scaled_frame : frame;
-                    DrawBoxes(alarm_frame, detections);
-                    PostAlarmPhoto(alarm_frame, detections);
+                    if (dual_stream && has_frame) {
+                        // Draw boxes on main stream frame, scaled the same way as single-stream alarm photo
+                        cv::Mat alarm_frame;
+                        if (settings_.use_image_scale) {
+                            cv::resize(frame, alarm_frame, cv::Size(0, 0), settings_.img_scale_x, settings_.img_scale_y, cv::INTER_AREA);
+                        } else {
+                            alarm_frame = frame.clone();
+                        }
+                        const auto alarm_detections = ScaleDetections(detections, detect_frame.size(), alarm_frame.size());
+                        DrawBoxes(alarm_frame, alarm_detections);
+                        PostAlarmPhoto(std::move(alarm_frame), alarm_detections);
+                    } else {
+                        // Frame is shared with the frame slot or video writer, and scaled frame buffer is reused for the next
+                        // frames, so it's copied before drawing and passing to photo thread
+                        cv::Mat alarm_frame = detect_frame.clone();
+                        DrawBoxes(alarm_frame, detections);
+                        PostAlarmPhoto(std::move(alarm_frame), detections);
+                    }
                     last_alarm_video_uid_ = video_uid;
                 }
             } else {  // Not detected
+                if (!video_writer_ && use_pre_event_frames_ && has_frame)
+                    StorePreEventFrame(frame);
+
                 if (video_writer_) {
-                    video_writer_->AddFrame(std::move(frame));
+                    AddVideoFrame(std::move(frame), detect_source_frame);
 
                     if (!first_cooldown_frame_timestamp_) {
                         LOG_INFO << "Start cooldown writing";
@@ -174,15 +462,8 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
                     } else {
                         LOG_TRACE << "Cooldown frame saved";
                         if (IsCooldownFinished()) {
-                            const auto uid = video_writer_->GetUid();
-                            LOG_INFO << "Finish writing file with uid = " << uid;
-                            const auto preview_file_path = SaveVideoPreview(uid);
-                            if (settings_.send_video_previews)
-                                PostVideoPreview(preview_file_path);
-                            if (settings_.send_video)
-                                PostVideo(uid);
+                            FinishVideoWriter();
                             // Stop cooldown
-                            video_writer_.reset();
                             first_cooldown_frame_timestamp_.reset();
                         }
                     }
@@ -192,6 +473,77 @@ void Core::ProcessingThreadFunc(std::stop_token stop_token) {
     }
 }
 
+void Core::FinishVideoWriter() {
+    const auto uid = video_writer_->GetUid();
+    LOG_INFO << "Finish writing file with uid = " << uid;
+    recording_.store(false);
+    recording_packets_.store(false);
+    FinishedVideo finished_video{
+        std::move(video_writer_),
+        RecordingsIndex::Recording{
+            uid,
+            GetTimestampFromUid(uid),
+            0,
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - recording_start_),
+            {},
+            {begin(recording_classes_), end(recording_classes_)}
+        }
+    };
+    if (settings_.async_video_writer_settings.enabled) {
+        // Next video might be started right away, while this one is being finalized
+        {
+            std::lock_guard lock(finalize_mutex_);
+            finalize_queue_.push_back(std::move(finished_video));
+        }
+        finalize_cv_.notify_all();
+    } else {
+        FinalizeVideo(std::move(finished_video));
+    }
+}
+
+void Core::FinalizeVideo(FinishedVideo finished_video) {
+    auto& video_writer = finished_video.video_writer;
+    auto& recording = finished_video.recording;
+    const auto uid = recording.uid;
+    const auto preview_file_path = SaveVideoPreview(*video_writer);
+    if (settings_.send_video_previews)
+        PostVideoPreview(preview_file_path);
+    video_writer.reset();  // File is closed here
+    LOG_INFO << "Video file with uid = " << uid << " finalized";
+
+    // Part files are checked one by one, which is much cheaper than directory scan
+    for (size_t part_number = 1; ; ++part_number) {
+        const auto file_name = VideoWriter::GeneratePartFileName(uid, part_number);
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(settings_.storage_path / file_name, ec);
+        if (ec)
+            break;
+        recording.size_bytes += static_cast<size_t>(size);
+        recording.part_files.push_back(file_name);
+    }
+    if (!recording.part_files.empty())
+        recordings_index_->Add(std::move(recording));
+    if (storage_retention_)
+        storage_retention_->AddVideo(uid, VideoWriter::kVideoFilePrefix);
+
+    if (settings_.send_video && !video_parts_posted_.load())  // Otherwise parts are already posted by writer
+        PostVideo(uid);
+}
+
+void Core::FinalizeThreadFunc(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(finalize_mutex_);
+        finalize_cv_.wait(lock, [&] { return !finalize_queue_.empty() || stop_token.stop_requested(); });
+        if (finalize_queue_.empty())  // Stop is requested, and all videos are finalized
+            break;
+
+        auto finished_video = std::move(finalize_queue_.front());
+        finalize_queue_.pop_front();
+        lock.unlock();
+        FinalizeVideo(std::move(finished_video));
+    }
+}
+
 bool Core::IsCooldownFinished() const {
     return std::chrono::steady_clock::now() - *first_cooldown_frame_timestamp_ > std::chrono::milliseconds(settings_.cooldown_write_time_ms);
 }
@@ -200,31 +552,93 @@ bool Core::IsAlarmImageDelayPassed() const {
     return std::chrono::steady_clock::now() - last_alarm_photo_sent_ > std::chrono::milliseconds(settings_.alarm_notification_delay_ms);
 }
 
+void Core::HandleGetFrameError(FrameReader& frame_reader, size_t& error_count, ErrorReporter& error_reporter) {
+    ++error_count;
+    LOG_ERROR_EX << "Can't get frame";
+    error_reporter.Update(ErrorReporter::ErrorState::kError);
+
+    if (error_count >= settings_.errors_before_reconnect) {
+        LOG_INFO << "Reconnect";
+        error_count = 0;
+        frame_reader.Reconnect();
+    } else {
+        LOG_INFO << "Delay after error, error count = " << error_count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(settings_.delay_after_error_ms));
+    }
+}
+
+void Core::DetectCaptureThreadFunc(std::stop_token stop_token) {
+    // Sub-stream is small, so every frame is decoded and the latest one is kept for processing
+    cv::Mat frame{};
+    size_t error_count = 0;
+    while (!stop_token.stop_requested()) [[unlikely]] {
+        if (!detect_frame_reader_->GetFrame(frame)) [[unlikely]] {
+            HandleGetFrameError(*detect_frame_reader_, error_count, detect_frame_reader_error_);
+        } else {
+            detect_frame_reader_error_.Update(ErrorReporter::ErrorState::kNoError);
+            error_count = 0;
+            detect_frame_slot_.Publish(std::move(frame));
+        }
+    }
+}
+
 void Core::CaptureThreadFunc(std::stop_token stop_token) {
+    const bool dual_stream = static_cast<bool>(detect_frame_reader_);
     cv::Mat frame{};
+    cv::Mat detect_frame{};
+    uint64_t frame_idx = 0;
+    uint64_t last_detect_frame_seq = 0;
+    uint64_t look_ahead_frames = 0;  // Single-stream only, sub-stream detect frames don't need main stream frames
     while (!stop_token.stop_requested()) [[unlikely]] {
-        if (!frame_reader_.GetFrame(frame)) [[unlikely]] {
-            ++get_frame_error_count_;
-            LOG_ERROR_EX << "Can't get frame";
-            frame_reader_error_.Update(ErrorReporter::ErrorState::kError);
-
-            if (get_frame_error_count_ >= settings_.errors_before_reconnect) {
-                LOG_INFO << "Reconnect";
-                get_frame_error_count_ = 0;
-                frame_reader_.Reconnect();
-            } else {
-                LOG_INFO << "Delay after error, error count = " << get_frame_error_count_;
-                std::this_thread::sleep_for(std::chrono::milliseconds(settings_.delay_after_error_ms));
+        // Every frame is grabbed to keep the stream in sync, but only required frames are decoded and converted
+        bool res = frame_reader_->Grab();
+        bool detect = false;
+        bool need_frame = false;
+        if (res) [[likely]] {
+            detect = (frame_idx++ % qos_.GetDetectInterval() == 0);
+            if (detect && dual_stream) {
+                // Detect on the latest sub-stream frame, if there's a new one
+                const auto latest = detect_frame_slot_.Get();
+                detect = latest && latest->seq != last_detect_frame_seq;
+                if (detect) {
+                    last_detect_frame_seq = latest->seq;
+                    detect_frame = latest->image;
+                }
             }
+            // On-demand photo is served from the latest decoded frame if it's recent, otherwise the next frame is decoded
+            const bool photo_requested = bot_.SomeoneIsWaitingForPhoto() && !PostOnDemandPhoto();
+            const bool look_ahead = look_ahead_frames > 0;
+            if (look_ahead)
+                --look_ahead_frames;
+            if (detect && !dual_stream)
+                look_ahead_frames = kDetectLookAheadFrames;
+            need_frame = (detect && !dual_stream) || recording_.load() || look_ahead || photo_requested;
+            if (need_frame) {
+                res = frame_reader_->Retrieve(frame);
+                // Frame is shared with snapshot readers, so it's never modified afterwards. Next frame is decoded
+                // into a new buffer, as this one is moved to processing
+                if (res && !frame.empty())
+                    snapshot_slot_.Publish(frame);
+                if (res && photo_requested)
+                    PostOnDemandPhoto();
+            }
+        }
+
+        if (!res) [[unlikely]] {
+            HandleGetFrameError(*frame_reader_, get_frame_error_count_, frame_reader_error_);
         } else {
             frame_reader_error_.Update(ErrorReporter::ErrorState::kNoError);
             get_frame_error_count_ = 0;
+            if (!need_frame && !detect && pending_packets_.empty())
+                continue;
+
             size_t buffer_size = 0;
             {
                 std::lock_guard lock(buffer_mutex_);
-                buffer_.emplace_back(std::move(frame));
+                buffer_.emplace_back(std::move(frame), std::move(detect_frame), detect, std::move(pending_packets_));
                 buffer_size = buffer_.size();
             }
+            pending_packets_.clear();
             buffer_cv_.notify_all();
 
             // Useful performance debug output
@@ -243,8 +657,15 @@ void Core::CaptureThreadFunc(std::stop_token stop_token) {
                 } else if (settings_.buffer_overflow_strategy == BufferOverflowStrategy::kDropHalf) {
                     LOG_WARNING << "Buffer size exceeds max (" << settings_.max_buffer_size << "), dropping half of cache";
                     std::lock_guard lock(buffer_mutex_);
-                    const size_t half = buffer_.size() / 2;
-                    buffer_.erase(begin(buffer_), begin(buffer_) + static_cast<decltype(buffer_)::difference_type>(half));
+                    const auto half = static_cast<decltype(buffer_)::difference_type>(buffer_.size() / 2);
+                    // Only decoded frames are dropped. Packets are passed to the first kept frame, as passthrough recording
+                    // can't skip any of them
+                    std::vector<EncodedPacket> dropped_packets;
+                    for (auto it = begin(buffer_); it != begin(buffer_) + half; ++it)
+                        std::move(begin(it->packets), end(it->packets), std::back_inserter(dropped_packets));
+                    auto& kept_packets = buffer_[static_cast<size_t>(half)].packets;
+                    kept_packets.insert(begin(kept_packets), std::make_move_iterator(begin(dropped_packets)), std::make_move_iterator(end(dropped_packets)));
+                    buffer_.erase(begin(buffer_), begin(buffer_) + half);
                 }
             }
         }
@@ -257,8 +678,15 @@ void Core::Start() {
         return;
     }
 
+    if (detect_frame_reader_)
+        detect_capture_thread_ = std::jthread(std::bind_front(&Core::DetectCaptureThreadFunc, this));
     capture_thread_ = std::jthread(std::bind_front(&Core::CaptureThreadFunc, this));
     processing_thread_ = std::jthread(std::bind_front(&Core::ProcessingThreadFunc, this));
+    photo_thread_ = std::jthread(std::bind_front(&Core::PhotoThreadFunc, this));
+    if (settings_.async_video_writer_settings.enabled)
+        finalize_thread_ = std::jthread(std::bind_front(&Core::FinalizeThreadFunc, this));
+    if (storage_retention_)
+        storage_retention_->Start();
 }
 
 void Core::Stop() {
@@ -270,11 +698,34 @@ void Core::Stop() {
                  << ", processing stop request result = " << processing_stop_requested;
     }
 
+    detect_capture_thread_.request_stop();
     buffer_cv_.notify_all();
 
     // In case this function is not called from within destructor, ensure that threads are stopped
+    if (detect_capture_thread_.joinable())
+        detect_capture_thread_.join();
     if (capture_thread_.joinable())
         capture_thread_.join();
     if (processing_thread_.joinable())
         processing_thread_.join();
+
+    // Videos which are already finished are finalized before stop
+    {
+        std::lock_guard lock(finalize_mutex_);
+        finalize_thread_.request_stop();
+    }
+    finalize_cv_.notify_all();
+    if (finalize_thread_.joinable())
+        finalize_thread_.join();
+
+    {
+        std::lock_guard lock(photo_mutex_);
+        photo_thread_.request_stop();
+    }
+    photo_cv_.notify_all();
+    if (photo_thread_.joinable())
+        photo_thread_.join();
+
+    if (storage_retention_)
+        storage_retention_->Stop();
 }
@@ -1,20 +1,32 @@
 #pragma once
 
 #include "ai.h"
+#include "archive_index.h"
+#include "continuous_recorder.h"
+#include "encoded_packet.h"
 #include "error_reporter.h"
 #include "frame_reader.h"
+#include "frame_slot.h"
+#include "pre_event_buffer.h"
+#include "qos_controller.h"
+#include "recordings_index.h"
 #include "settings.h"
+#include "static_scene_filter.h"
+#include "storage_retention.h"
 #include "telegram_bot_facade.h"
 #include "video_writer.h"
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 class Core final {
 public:
@@ -30,41 +42,104 @@ public:
     void Stop();
 
 private:
+    struct CapturedFrame {
+        cv::Mat frame;
+        cv::Mat detect_frame;  // Sub-stream frame for detect in dual-stream mode
+        bool detect{false};  // Frame should be passed to detect
+        std::vector<EncodedPacket> packets;  // Compressed packets read since previous captured frame
+    };
+    struct PendingPhoto {
+        cv::Mat frame;  // Not modified by other threads
+        std::filesystem::path file_path;
+        bool alarm{false};
+        std::string classes_detected;  // Alarm photo only
+        std::set<uint64_t> recipients;  // On-demand photo only, alarm photo goes to all users
+    };
+    struct FinishedVideo {
+        std::unique_ptr<VideoWriter> video_writer;
+        RecordingsIndex::Recording recording;  // Files info is filled when video is finalized
+    };
+
     void CaptureThreadFunc(std::stop_token stop_token);
+    void DetectCaptureThreadFunc(std::stop_token stop_token);
+    void HandleGetFrameError(FrameReader& frame_reader, size_t& error_count, ErrorReporter& error_reporter);
     void ProcessingThreadFunc(std::stop_token stop_token);
+    void FinalizeThreadFunc(std::stop_token stop_token);
+    void PhotoThreadFunc(std::stop_token stop_token);
 
-    void PostOnDemandPhoto(const cv::Mat& frame);
-    void PostAlarmPhoto(const cv::Mat& frame, const std::vector<Detection>& detections);
-    std::filesystem::path SaveVideoPreview(const std::string& video_file_uid);
+    bool PostOnDemandPhoto();  // Returns false if there's no recent enough frame
+    void PostAlarmPhoto(cv::Mat frame, const std::vector<Detection>& detections);
+    void QueuePhoto(PendingPhoto photo);
+    void EncodePhoto(PendingPhoto photo);
+    std::filesystem::path SaveVideoPreview(const VideoWriter& video_writer);
     void PostVideoPreview(const std::filesystem::path& file_path);
     void PostVideo(const std::string& uid);
 
     void DrawBoxes(const cv::Mat& frame, const std::vector<Detection>& detections);
     void InitVideoWriter();
+    void FinishVideoWriter();
+    void FinalizeVideo(FinishedVideo finished_video);
+    void AddVideoFrame(cv::Mat frame, const cv::Mat& detect_source_frame);
+    void StorePreEventFrame(const cv::Mat& frame);
+    void WritePreEventFrames();
     bool IsCooldownFinished() const;
     bool IsAlarmImageDelayPassed() const;
 
     const Settings settings_;
-    FrameReader frame_reader_;
+    std::unique_ptr<FrameReader> frame_reader_;
+    std::unique_ptr<FrameReader> detect_frame_reader_;  // Optional sub-stream reader
+    FrameSlot detect_frame_slot_;
+    FrameSlot snapshot_slot_;  // The latest decoded main stream frame, for on-demand photos
+    QosController qos_;
+    StaticSceneFilter static_scene_filter_;
+    // Pre-event packets are accessed from capture thread only, pre-event frames - from processing thread only
+    const bool use_pre_event_packets_;
+    const bool use_pre_event_frames_;
+    PreEventBuffer<EncodedPacket> pre_event_packets_;
+    PreEventBuffer<std::vector<uchar>> pre_event_frames_;  // Encoded frames, for writers which need frames
+    std::chrono::time_point<std::chrono::steady_clock> last_pre_event_frame_{};
+    std::shared_ptr<RecordingsIndex> recordings_index_;
     telegram::BotFacade bot_;
     std::unique_ptr<Ai> ai_;
     std::unique_ptr<VideoWriter> video_writer_;
+    std::unique_ptr<StorageRetention> storage_retention_;  // Optional
+    std::shared_ptr<ArchiveIndex> archive_index_;  // Present if continuous recording is enabled
+    std::unique_ptr<ContinuousRecorder> continuous_recorder_;
 
+    std::jthread detect_capture_thread_;
     std::jthread capture_thread_;
     std::jthread processing_thread_;
+    std::jthread finalize_thread_;
+    std::jthread photo_thread_;
 
     std::optional<std::chrono::time_point<std::chrono::steady_clock>> first_cooldown_frame_timestamp_;
     std::chrono::time_point<std::chrono::steady_clock> last_alarm_photo_sent_ = std::chrono::steady_clock::now() - std::chrono::hours(100);  // std::chrono::time_point<std::chrono::steady_clock>::max();
     std::chrono::time_point<std::chrono::steady_clock> last_checked_frame_ = std::chrono::steady_clock::now() - std::chrono::hours(100);  // std::chrono::time_point<std::chrono::steady_clock>::max();
 
     std::string last_alarm_video_uid_;
+    std::chrono::time_point<std::chrono::steady_clock> recording_start_{};
+    std::set<std::string> recording_classes_;  // Classes detected in the current video
+
+    std::atomic_bool recording_{false};  // Video writer needs decoded frames
+    std::atomic_bool recording_packets_{false};  // Video writer needs compressed packets
+    std::atomic_bool video_parts_posted_{false};  // Video parts are posted as soon as they are written
+    std::vector<EncodedPacket> pending_packets_;  // Accessed from capture thread only
 
-    std::deque<cv::Mat> buffer_;
+    std::deque<CapturedFrame> buffer_;
     std::mutex buffer_mutex_;
     std::condition_variable buffer_cv_;
 
+    std::deque<FinishedVideo> finalize_queue_;  // Finished writers, closed in background
+    std::mutex finalize_mutex_;
+    std::condition_variable finalize_cv_;
+
+    std::deque<PendingPhoto> photo_queue_;  // Photos are encoded and saved off the processing thread
+    std::mutex photo_mutex_;
+    std::condition_variable photo_cv_;
+
     size_t get_frame_error_count_{0};
 
     ErrorReporter ai_error_;
     ErrorReporter frame_reader_error_;
+    ErrorReporter detect_frame_reader_error_;
 };
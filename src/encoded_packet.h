@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// libav types are only forward declared, so this header is usable without libav
+struct AVCodecParameters;
+struct AVPacket;
+
+// Parameters of compressed video stream, required to mux its packets
+struct EncodedStreamInfo {
+    std::shared_ptr<const AVCodecParameters> codec_parameters;
+    int time_base_num{1};  // Time base of packets timestamps
+    int time_base_den{1000};
+    double fps{0.0};
+};
+
+// Compressed video packet as it was received from the source. Payload is reference counted, so copies are cheap
+struct EncodedPacket {
+    std::shared_ptr<const AVPacket> packet;
+    std::shared_ptr<const EncodedStreamInfo> stream;  // Same object while stream parameters are not changed
+    bool key_frame{false};
+    size_t size_bytes{0};
+};
@@ -1,25 +1,35 @@
 #pragma once
 
+#include "encoded_packet.h"
 #include "stream_properties.h"
 
 #include <opencv2/opencv.hpp>
 
-#include <memory>
-#include <optional>
-#include <string>
+#include <chrono>
+#include <functional>
 
-class FrameReader final {
+class FrameReader {
 public:
-    explicit FrameReader(std::string source);
+    using PacketHandler = std::function<void(EncodedPacket)>;
 
-    bool Open();
-    bool Reconnect();
+    virtual ~FrameReader() = default;
 
-    bool GetFrame(cv::Mat& frame);
-    StreamProperties GetStreamProperties() const;
+    virtual bool Open() = 0;
+    virtual bool Reconnect() = 0;
 
-private:
-    const std::string source_;
-    std::unique_ptr<cv::VideoCapture> capture_;
-    mutable std::optional<StreamProperties> stream_properties_;
+    virtual bool GetFrame(cv::Mat& frame) {
+        return Grab() && Retrieve(frame);
+    }
+    // Split version of GetFrame(): Grab() every frame to keep stream in sync, Retrieve() only required ones
+    virtual bool Grab() = 0;
+    virtual bool Retrieve(cv::Mat& frame) = 0;
+
+    virtual StreamProperties GetStreamProperties() const = 0;
+    virtual std::chrono::milliseconds GetFramePts() const = 0;  // Presentation timestamp of the last grabbed frame
+
+    // Compressed packets of video stream are passed to handler from within Grab(), as they are read.
+    // Returns false if reader has no access to compressed packets
+    virtual bool SetPacketHandler(PacketHandler /*handler*/) {
+        return false;
+    }
 };
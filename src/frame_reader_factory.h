@@ -0,0 +1,25 @@
+#pragma once
+
+#include "frame_reader.h"
+#include "opencv_frame_reader.h"
+#include "settings.h"
+
+#ifdef USE_LIBAV
+#include "libav_frame_reader.h"
+#endif
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+inline std::unique_ptr<FrameReader> FrameReaderFactory(const Settings& settings, const std::string& source) {
+    if (settings.use_libav_reader) {
+#ifdef USE_LIBAV
+        return std::make_unique<LibavFrameReader>(source, settings.libav_reader_settings);
+#else
+        throw std::runtime_error("libav frame reader requested, but application is built without libav support");
+#endif
+    } else {
+        return std::make_unique<OpenCvFrameReader>(source);
+    }
+}
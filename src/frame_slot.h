@@ -0,0 +1,32 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+// Single-frame slot holding the most recent frame. It's never waited on for long: access is just a pointer swap (atomic
+// shared_ptr might use internal lock, e. g. in libstdc++), frames are neither copied nor waited for.
+// Published image should not be modified afterwards - it is shared with readers
+class FrameSlot final {
+public:
+    struct Frame {
+        cv::Mat image;
+        uint64_t seq{0};
+        std::chrono::steady_clock::time_point timestamp;
+    };
+
+    void Publish(cv::Mat image) {
+        const auto seq = seq_.fetch_add(1, std::memory_order_relaxed) + 1;
+        frame_.store(std::make_shared<const Frame>(std::move(image), seq, std::chrono::steady_clock::now()));
+    }
+
+    std::shared_ptr<const Frame> Get() const {
+        return frame_.load();
+    }
+
+private:
+    std::atomic<std::shared_ptr<const Frame>> frame_;
+    std::atomic<uint64_t> seq_{0};
+};
@@ -0,0 +1,299 @@
+#include "libav_frame_reader.h"
+
+#include "libav_utils.h"
+#include "log.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+LibavFrameReader::LibavFrameReader(std::string source, Settings::LibavReaderSettings settings)
+    : source_(std::move(source))
+    , settings_(std::move(settings))
+    , packet_(av_packet_alloc())
+    , frame_(av_frame_alloc()) {
+    if (!packet_ || !frame_) {
+        static const auto err_msg = "Unable to allocate libav packet or frame";
+        LOG_ERROR_EX << err_msg;
+        throw std::runtime_error(err_msg);
+    }
+}
+
+LibavFrameReader::~LibavFrameReader() {
+    CloseDecoder();
+    CloseInput();
+    sws_freeContext(sws_ctx_);
+    av_frame_free(&frame_);
+    av_packet_free(&packet_);
+}
+
+int LibavFrameReader::InterruptCallback(void* opaque) {
+    const auto* reader = static_cast<const LibavFrameReader*>(opaque);
+    return std::chrono::steady_clock::now() > reader->io_deadline_ ? 1 : 0;
+}
+
+void LibavFrameReader::ResetDeadline() {
+    io_deadline_ = std::chrono::steady_clock::now() + settings_.timeout;
+}
+
+bool LibavFrameReader::OpenInput() {
+    format_ctx_ = avformat_alloc_context();
+    if (!format_ctx_) {
+        LOG_ERROR_EX << "Unable to allocate format context";
+        return false;
+    }
+    format_ctx_->interrupt_callback = {&LibavFrameReader::InterruptCallback, this};
+
+    AVDictionary* options = nullptr;
+    if (source_.starts_with("rtsp://") || source_.starts_with("rtsps://")) {
+        if (!settings_.rtsp_transport.empty())
+            av_dict_set(&options, "rtsp_transport", settings_.rtsp_transport.c_str(), 0);
+        av_dict_set_int(&options, "timeout", std::chrono::microseconds(settings_.timeout).count(), 0);
+        if (settings_.reorder_queue_size >= 0)
+            av_dict_set_int(&options, "reorder_queue_size", settings_.reorder_queue_size, 0);
+    }
+    if (settings_.probe_size > 0)
+        av_dict_set_int(&options, "probesize", settings_.probe_size, 0);
+    if (settings_.analyze_duration.count() > 0)
+        av_dict_set_int(&options, "analyzeduration", std::chrono::microseconds(settings_.analyze_duration).count(), 0);
+    if (settings_.low_delay)
+        av_dict_set(&options, "fflags", "nobuffer", 0);
+
+    ResetDeadline();
+    // NB: format_ctx_ is freed by avformat_open_input() on failure
+    auto res = avformat_open_input(&format_ctx_, source_.c_str(), nullptr, &options);
+    av_dict_free(&options);
+    if (res < 0) {
+        LOG_ERROR_EX << "avformat_open_input() failed for source \"" + source_ + "\": " << AvErrorToString(res);
+        return false;
+    }
+
+    ResetDeadline();
+    res = avformat_find_stream_info(format_ctx_, nullptr);
+    if (res < 0) {
+        LOG_ERROR_EX << "avformat_find_stream_info() failed: " << AvErrorToString(res);
+        CloseInput();
+        return false;
+    }
+
+    stream_idx_ = av_find_best_stream(format_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (stream_idx_ < 0) {
+        LOG_ERROR_EX << "No video stream found in source \"" + source_ + "\"";
+        CloseInput();
+        return false;
+    }
+
+    const auto* stream = format_ctx_->streams[stream_idx_];
+    time_base_ = stream->time_base;
+    const auto frame_rate = stream->avg_frame_rate.num > 0 ? stream->avg_frame_rate : stream->r_frame_rate;
+    stream_properties_.fps = frame_rate.den > 0 ? av_q2d(frame_rate) : 0.0;
+    stream_properties_.width = stream->codecpar->width;
+    stream_properties_.height = stream->codecpar->height;
+    LOG_INFO << "Obtained stream properties: fps = " << stream_properties_.fps << ", width = "
+             << stream_properties_.width << ", height = " << stream_properties_.height;
+    UpdateEncodedStreamInfo();
+    return true;
+}
+
+void LibavFrameReader::UpdateEncodedStreamInfo() {
+    // Stream info object is kept on reconnect if parameters are the same, so writers may continue with new packets
+    const auto* stream = format_ctx_->streams[stream_idx_];
+    const auto* codecpar = stream->codecpar;
+    if (encoded_stream_info_) {
+        const auto* prev = encoded_stream_info_->codec_parameters.get();
+        if (prev->codec_id == codecpar->codec_id && prev->width == codecpar->width && prev->height == codecpar->height
+            && prev->extradata_size == codecpar->extradata_size
+            && encoded_stream_info_->time_base_num == stream->time_base.num
+            && encoded_stream_info_->time_base_den == stream->time_base.den
+            && (prev->extradata_size == 0 || std::memcmp(prev->extradata, codecpar->extradata, prev->extradata_size) == 0)) {
+            return;
+        }
+    }
+
+    std::shared_ptr<AVCodecParameters> codec_parameters(avcodec_parameters_alloc(), [](AVCodecParameters* p) {
+        avcodec_parameters_free(&p);
+    });
+    if (!codec_parameters || avcodec_parameters_copy(codec_parameters.get(), codecpar) < 0) {
+        LOG_ERROR_EX << "Unable to copy codec parameters";
+        encoded_stream_info_.reset();
+        return;
+    }
+    encoded_stream_info_ = std::make_shared<const EncodedStreamInfo>(
+        std::move(codec_parameters), stream->time_base.num, stream->time_base.den, stream_properties_.fps);
+}
+
+void LibavFrameReader::PassPacket() {
+    if (!encoded_stream_info_) [[unlikely]]
+        return;
+
+    // Clone references packet data, payload is not copied
+    std::shared_ptr<const AVPacket> packet(av_packet_clone(packet_), [](AVPacket* p) { av_packet_free(&p); });
+    if (!packet) [[unlikely]] {
+        LOG_ERROR_EX << "Unable to clone packet";
+        return;
+    }
+    const bool key_frame = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+    const auto size_bytes = static_cast<size_t>(packet->size);
+    packet_handler_(EncodedPacket{std::move(packet), encoded_stream_info_, key_frame, size_bytes});
+}
+
+bool LibavFrameReader::SetPacketHandler(PacketHandler handler) {
+    packet_handler_ = std::move(handler);
+    return true;
+}
+
+void LibavFrameReader::CloseInput() {
+    if (format_ctx_)
+        avformat_close_input(&format_ctx_);
+}
+
+bool LibavFrameReader::OpenDecoder() {
+    const auto* codecpar = format_ctx_->streams[stream_idx_]->codecpar;
+    const auto* codec = avcodec_find_decoder(codecpar->codec_id);
+    if (!codec) {
+        LOG_ERROR_EX << "Decoder not found, codec id = " << codecpar->codec_id;
+        return false;
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_) {
+        LOG_ERROR_EX << "Unable to allocate codec context";
+        return false;
+    }
+
+    auto res = avcodec_parameters_to_context(codec_ctx_, codecpar);
+    if (res < 0) {
+        LOG_ERROR_EX << "avcodec_parameters_to_context() failed: " << AvErrorToString(res);
+        CloseDecoder();
+        return false;
+    }
+
+    codec_ctx_->thread_count = settings_.decoder_threads;  // 0 - auto
+    // Frame threading adds a frame of latency per thread, so only slice threading is used in low delay mode
+    codec_ctx_->thread_type = settings_.low_delay ? FF_THREAD_SLICE : (FF_THREAD_FRAME | FF_THREAD_SLICE);
+    if (settings_.low_delay)
+        codec_ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    res = avcodec_open2(codec_ctx_, codec, nullptr);
+    if (res < 0) {
+        LOG_ERROR_EX << "avcodec_open2() failed: " << AvErrorToString(res);
+        CloseDecoder();
+        return false;
+    }
+    LOG_INFO << "Decoder opened: " << codec->name << ", threads = " << codec_ctx_->thread_count;
+    return true;
+}
+
+void LibavFrameReader::CloseDecoder() {
+    if (codec_ctx_)
+        avcodec_free_context(&codec_ctx_);
+}
+
+bool LibavFrameReader::Open() {
+    CloseDecoder();
+    CloseInput();
+    const auto res = OpenInput() && OpenDecoder();
+    LOG_INFO_EX << "LibavFrameReader::Open(): " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    flush_sent_ = false;
+    frame_ready_ = false;
+    return res;
+}
+
+bool LibavFrameReader::Reconnect() {
+    // Fast path: only the input is reopened, decoder is kept if stream parameters are not changed
+    CloseInput();
+    auto res = OpenInput();
+    if (res) {
+        const auto* codecpar = format_ctx_->streams[stream_idx_]->codecpar;
+        if (codec_ctx_ && codec_ctx_->codec_id == codecpar->codec_id && codec_ctx_->width == codecpar->width
+            && codec_ctx_->height == codecpar->height) {
+            avcodec_flush_buffers(codec_ctx_);
+        } else {
+            LOG_INFO << "Stream parameters changed, reopen decoder";
+            CloseDecoder();
+            res = OpenDecoder();
+        }
+    }
+    flush_sent_ = false;
+    frame_ready_ = false;
+
+    LOG_INFO_EX << "LibavFrameReader::Reconnect(): " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    if (!res)
+        LOG_ERROR_EX << "LibavFrameReader::Reconnect() error: " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    return res;
+}
+
+bool LibavFrameReader::Grab() {
+    frame_ready_ = false;
+    if (!format_ctx_ || !codec_ctx_) [[unlikely]] {
+        LOG_ERROR_EX << "LibavFrameReader::Grab() called for closed source";
+        return false;
+    }
+
+    ResetDeadline();
+    while (true) {
+        auto res = avcodec_receive_frame(codec_ctx_, frame_);
+        if (res == 0) {
+            const auto pts = frame_->best_effort_timestamp;
+            if (pts != AV_NOPTS_VALUE)
+                frame_pts_ = std::chrono::milliseconds(av_rescale_q(pts, time_base_, AVRational{1, 1000}));
+            frame_ready_ = true;
+            return true;
+        }
+        if (res != AVERROR(EAGAIN)) {
+            LOG_ERROR_EX << "avcodec_receive_frame() failed: " << AvErrorToString(res);
+            return false;
+        }
+
+        res = av_read_frame(format_ctx_, packet_);
+        if (res == AVERROR_EOF && !flush_sent_) {
+            // Drain frames buffered in decoder
+            flush_sent_ = true;
+            avcodec_send_packet(codec_ctx_, nullptr);
+            continue;
+        }
+        if (res < 0) {
+            LOG_ERROR_EX << "av_read_frame() failed: " << AvErrorToString(res);
+            return false;
+        }
+
+        if (packet_->stream_index == stream_idx_) {
+            if (packet_handler_)
+                PassPacket();
+            res = avcodec_send_packet(codec_ctx_, packet_);
+            if (res < 0 && res != AVERROR(EAGAIN))
+                LOG_WARNING_EX << "avcodec_send_packet() failed: " << AvErrorToString(res);
+        }
+        av_packet_unref(packet_);
+    }
+}
+
+bool LibavFrameReader::Retrieve(cv::Mat& frame) {
+    if (!frame_ready_) [[unlikely]] {
+        LOG_ERROR_EX << "LibavFrameReader::Retrieve() called without grabbed frame";
+        return false;
+    }
+
+    const auto width = frame_->width;
+    const auto height = frame_->height;
+    sws_ctx_ = sws_getCachedContext(sws_ctx_, width, height, static_cast<AVPixelFormat>(frame_->format),
+                                    width, height, AV_PIX_FMT_BGR24, SWS_POINT, nullptr, nullptr, nullptr);
+    if (!sws_ctx_) {
+        LOG_ERROR_EX << "Unable to create sws context";
+        return false;
+    }
+
+    frame.create(height, width, CV_8UC3);
+    uint8_t* dst_data[4] = {frame.data, nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {static_cast<int>(frame.step[0]), 0, 0, 0};
+    sws_scale(sws_ctx_, frame_->data, frame_->linesize, 0, height, dst_data, dst_linesize);
+    return true;
+}
+
+StreamProperties LibavFrameReader::GetStreamProperties() const {
+    return stream_properties_;
+}
+
+std::chrono::milliseconds LibavFrameReader::GetFramePts() const {
+    return frame_pts_;
+}
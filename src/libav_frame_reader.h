@@ -0,0 +1,72 @@
+#pragma once
+
+#include "encoded_packet.h"
+#include "frame_reader.h"
+#include "settings.h"
+#include "stream_properties.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+// Frame reader based on libavformat/libavcodec directly, which allows to tune RTSP and decoder options
+class LibavFrameReader final : public FrameReader {
+public:
+    LibavFrameReader(std::string source, Settings::LibavReaderSettings settings);
+    ~LibavFrameReader();
+
+    LibavFrameReader(const LibavFrameReader&) = delete;
+    LibavFrameReader(LibavFrameReader&&) = delete;
+    LibavFrameReader& operator=(const LibavFrameReader&) = delete;
+    LibavFrameReader& operator=(LibavFrameReader&&) = delete;
+
+    bool Open() override;
+    bool Reconnect() override;
+
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override;
+
+    StreamProperties GetStreamProperties() const override;
+    std::chrono::milliseconds GetFramePts() const override;
+
+    bool SetPacketHandler(PacketHandler handler) override;
+
+private:
+    bool OpenInput();
+    void CloseInput();
+    bool OpenDecoder();
+    void CloseDecoder();
+    void ResetDeadline();
+    void UpdateEncodedStreamInfo();
+    void PassPacket();
+
+    static int InterruptCallback(void* opaque);
+
+    const std::string source_;
+    const Settings::LibavReaderSettings settings_;
+
+    AVFormatContext* format_ctx_{nullptr};
+    AVCodecContext* codec_ctx_{nullptr};
+    SwsContext* sws_ctx_{nullptr};
+    AVPacket* packet_{nullptr};
+    AVFrame* frame_{nullptr};
+    int stream_idx_{-1};
+    AVRational time_base_{1, 1000};
+    bool flush_sent_{false};
+    bool frame_ready_{false};
+
+    std::chrono::steady_clock::time_point io_deadline_{};
+    std::chrono::milliseconds frame_pts_{0};
+    StreamProperties stream_properties_{};
+
+    PacketHandler packet_handler_;
+    std::shared_ptr<const EncodedStreamInfo> encoded_stream_info_;
+};
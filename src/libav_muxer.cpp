@@ -0,0 +1,84 @@
+#include "libav_muxer.h"
+
+#include "libav_utils.h"
+#include "log.h"
+
+#include <stdexcept>
+#include <string>
+
+LibavMuxer::LibavMuxer(const std::filesystem::path& file_path, const AVCodecParameters& codec_parameters, AVRational time_base,
+                       std::chrono::milliseconds fragment_duration)
+    : file_path_(file_path)
+    , in_time_base_(time_base) {
+    const auto file_name = file_path_.generic_string();
+    auto res = avformat_alloc_output_context2(&format_ctx_, nullptr, nullptr, file_name.c_str());
+    if (res < 0 || !format_ctx_) {
+        const auto msg = "Unable to create output context for " + file_name + ": " + AvErrorToString(res);
+        LOG_ERROR_EX << msg;
+        throw std::runtime_error(msg);
+    }
+
+    const auto fail = [this](const std::string& msg) {
+        LOG_ERROR_EX << msg;
+        if (format_ctx_->pb)
+            avio_closep(&format_ctx_->pb);
+        avformat_free_context(format_ctx_);
+        throw std::runtime_error(msg);
+    };
+
+    stream_ = avformat_new_stream(format_ctx_, nullptr);
+    if (!stream_)
+        fail("Unable to create output stream for " + file_name);
+
+    res = avcodec_parameters_copy(stream_->codecpar, &codec_parameters);
+    if (res < 0)
+        fail("Unable to copy codec parameters: " + AvErrorToString(res));
+    // Source container tag is not necessarily valid for output container, so let the muxer choose it.
+    // HEVC in mp4 is tagged as hvc1, otherwise some players refuse it
+    stream_->codecpar->codec_tag = 0;
+    if (codec_parameters.codec_id == AV_CODEC_ID_HEVC && std::string(format_ctx_->oformat->name).find("mp4") != std::string::npos)
+        stream_->codecpar->codec_tag = MKTAG('h', 'v', 'c', '1');
+    stream_->time_base = in_time_base_;
+
+    if (!(format_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        res = avio_open(&format_ctx_->pb, file_name.c_str(), AVIO_FLAG_WRITE);
+        if (res < 0)
+            fail("Unable to open file for writing: " + file_name + ", " + AvErrorToString(res));
+    }
+
+    AVDictionary* options = nullptr;
+    if (fragment_duration.count() > 0) {
+        // Each fragment is self-contained, so moov atom at the end of file is not required
+        if (std::string(format_ctx_->oformat->name).find("mp4") != std::string::npos) {
+            av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+            av_dict_set_int(&options, "frag_duration", std::chrono::microseconds(fragment_duration).count(), 0);
+        }
+        format_ctx_->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+    }
+    res = avformat_write_header(format_ctx_, &options);
+    av_dict_free(&options);
+    if (res < 0)
+        fail("avformat_write_header() failed for " + file_name + ": " + AvErrorToString(res));
+    LOG_INFO << "Muxer opened file " << file_name;
+}
+
+LibavMuxer::~LibavMuxer() {
+    const auto res = av_write_trailer(format_ctx_);
+    if (res < 0)
+        LOG_ERROR_EX << "av_write_trailer() failed for " << file_path_.generic_string() << ": " << AvErrorToString(res);
+    if (!(format_ctx_->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&format_ctx_->pb);
+    avformat_free_context(format_ctx_);
+}
+
+bool LibavMuxer::Write(AVPacket& packet) {
+    packet.stream_index = stream_->index;
+    av_packet_rescale_ts(&packet, in_time_base_, stream_->time_base);
+    packet.pos = -1;
+    const auto res = av_interleaved_write_frame(format_ctx_, &packet);
+    if (res < 0) {
+        LOG_ERROR_EX << "av_interleaved_write_frame() failed: " << AvErrorToString(res);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include <chrono>
+#include <filesystem>
+
+// Writes compressed video packets into container file. Container format is guessed from file extension.
+// If fragment duration is set, mp4 is written as fragmented one, and data is flushed to file as soon as it's written,
+// so the file is playable while it's being written (or if application is killed)
+class LibavMuxer final {
+public:
+    LibavMuxer(const std::filesystem::path& file_path, const AVCodecParameters& codec_parameters, AVRational time_base,
+               std::chrono::milliseconds fragment_duration = std::chrono::milliseconds(0));
+    ~LibavMuxer();
+
+    LibavMuxer(const LibavMuxer&) = delete;
+    LibavMuxer(LibavMuxer&&) = delete;
+    LibavMuxer& operator=(const LibavMuxer&) = delete;
+    LibavMuxer& operator=(LibavMuxer&&) = delete;
+
+    // Packet timestamps are expected in time base passed to constructor. Packet data is consumed
+    bool Write(AVPacket& packet);
+
+private:
+    const std::filesystem::path file_path_;
+    const AVRational in_time_base_;
+    AVFormatContext* format_ctx_{nullptr};
+    AVStream* stream_{nullptr};
+};
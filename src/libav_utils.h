@@ -0,0 +1,13 @@
+#pragma once
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+#include <string>
+
+inline std::string AvErrorToString(int error) {
+    char buffer[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(error, buffer, sizeof(buffer));
+    return buffer;
+}
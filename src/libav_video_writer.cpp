@@ -0,0 +1,194 @@
+#include "libav_video_writer.h"
+
+#include "libav_utils.h"
+#include "log.h"
+#include "uid_utils.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <stdexcept>
+#include <string>
+
+constexpr double kDefaultFps = 25.0;  // Used if source doesn't report its fps
+
+LibavVideoWriter::LibavVideoWriter(const Settings& settings, const StreamProperties& out_properties)
+    : VideoWriter(settings)
+    , frame_(av_frame_alloc())
+    , packet_(av_packet_alloc()) {
+    const auto file_name = GenerateFileName(kVideoFilePrefix, &uid_) + kVideoFileExtension;
+    try {
+        if (!frame_ || !packet_) {
+            static const auto err_msg = "Unable to allocate libav packet or frame";
+            LOG_ERROR_EX << err_msg;
+            throw std::runtime_error(err_msg);
+        }
+
+        // Some containers (e. g. mp4) require codec headers to be stored globally instead of in-stream
+        const auto* output_format = av_guess_format(nullptr, file_name.c_str(), nullptr);
+        const bool global_header = output_format && (output_format->flags & AVFMT_GLOBALHEADER);
+        OpenEncoder(settings.libav_writer_settings, out_properties, global_header);
+
+        AVCodecParameters* codec_parameters = avcodec_parameters_alloc();
+        if (!codec_parameters || avcodec_parameters_from_context(codec_parameters, codec_ctx_) < 0) {
+            avcodec_parameters_free(&codec_parameters);
+            static const auto err_msg = "Unable to obtain encoder parameters";
+            LOG_ERROR_EX << err_msg;
+            throw std::runtime_error(err_msg);
+        }
+        try {
+            muxer_ = std::make_unique<SegmentedMuxer>(settings, kVideoFilePrefix, uid_, *codec_parameters, codec_ctx_->time_base);
+        } catch (...) {
+            avcodec_parameters_free(&codec_parameters);
+            throw;
+        }
+        avcodec_parameters_free(&codec_parameters);
+    } catch (...) {
+        Close();
+        throw;
+    }
+    LOG_INFO << "Video writer opened file with uid = " << uid_;
+}
+
+LibavVideoWriter::~LibavVideoWriter() {
+    Encode(nullptr);
+    Close();
+
+    ReportStats("libav", static_cast<size_t>(next_pts_), encode_time_, static_cast<double>(next_pts_) * av_q2d(time_base_), bytes_written_);
+}
+
+void LibavVideoWriter::OpenEncoder(const Settings::LibavWriterSettings& settings, const StreamProperties& out_properties, bool global_header) {
+    const auto* codec = avcodec_find_encoder_by_name(settings.codec.c_str());
+    if (!codec) {
+        const auto msg = "Encoder not found: " + settings.codec;
+        LOG_ERROR_EX << msg;
+        throw std::runtime_error(msg);
+    }
+
+    const auto pix_fmt = av_get_pix_fmt(settings.pix_fmt.c_str());
+    if (pix_fmt == AV_PIX_FMT_NONE) {
+        const auto msg = "Unknown pixel format: " + settings.pix_fmt;
+        LOG_ERROR_EX << msg;
+        throw std::runtime_error(msg);
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_) {
+        static const auto err_msg = "Unable to allocate codec context";
+        LOG_ERROR_EX << err_msg;
+        throw std::runtime_error(err_msg);
+    }
+
+    const auto fps = out_properties.fps > 0.0 ? out_properties.fps : kDefaultFps;
+    codec_ctx_->width = out_properties.width;
+    codec_ctx_->height = out_properties.height;
+    codec_ctx_->pix_fmt = pix_fmt;
+    codec_ctx_->framerate = av_d2q(fps, 100'000);
+    codec_ctx_->time_base = av_inv_q(codec_ctx_->framerate);
+    time_base_ = codec_ctx_->time_base;
+    codec_ctx_->gop_size = settings.gop_size;
+    codec_ctx_->thread_count = settings.threads;  // 0 - auto
+    if (global_header)
+        codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary* options = nullptr;
+    if (!settings.preset.empty())
+        av_dict_set(&options, "preset", settings.preset.c_str(), 0);
+    if (!settings.tune.empty())
+        av_dict_set(&options, "tune", settings.tune.c_str(), 0);
+    if (settings.crf >= 0)
+        av_dict_set_int(&options, "crf", settings.crf, 0);
+
+    const auto res = avcodec_open2(codec_ctx_, codec, &options);
+    // Options not consumed by the encoder are left in the dictionary
+    for (const AVDictionaryEntry* entry = nullptr; (entry = av_dict_get(options, "", entry, AV_DICT_IGNORE_SUFFIX));)
+        LOG_WARNING << "Encoder " << codec->name << " doesn't support option " << entry->key;
+    av_dict_free(&options);
+    if (res < 0) {
+        const auto msg = "avcodec_open2() failed for encoder " + settings.codec + ": " + AvErrorToString(res);
+        LOG_ERROR_EX << msg;
+        throw std::runtime_error(msg);
+    }
+
+    frame_->format = codec_ctx_->pix_fmt;
+    frame_->width = codec_ctx_->width;
+    frame_->height = codec_ctx_->height;
+    if (av_frame_get_buffer(frame_, 0) < 0) {
+        static const auto err_msg = "Unable to allocate frame buffer";
+        LOG_ERROR_EX << err_msg;
+        throw std::runtime_error(err_msg);
+    }
+    LOG_INFO << "Encoder opened: " << codec->name << ", preset = " << settings.preset << ", crf = " << settings.crf
+             << ", threads = " << codec_ctx_->thread_count << ", gop = " << codec_ctx_->gop_size << ", pix_fmt = "
+             << settings.pix_fmt;
+}
+
+void LibavVideoWriter::Close() {
+    muxer_.reset();
+    if (codec_ctx_)
+        avcodec_free_context(&codec_ctx_);
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+    av_frame_free(&frame_);
+    av_packet_free(&packet_);
+}
+
+bool LibavVideoWriter::SetPartFinishedCallback(PartFinishedCallback callback) {
+    muxer_->SetPartFinishedCallback(std::move(callback));
+    return true;
+}
+
+void LibavVideoWriter::AddFrame(cv::Mat frame) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Color conversion and scale are done in a single pass
+    const int scale_algorithm = frame.cols > codec_ctx_->width ? SWS_AREA : SWS_BICUBIC;
+    sws_ctx_ = sws_getCachedContext(sws_ctx_, frame.cols, frame.rows, AV_PIX_FMT_BGR24,
+                                    codec_ctx_->width, codec_ctx_->height, codec_ctx_->pix_fmt,
+                                    scale_algorithm, nullptr, nullptr, nullptr);
+    if (!sws_ctx_) [[unlikely]] {
+        LOG_ERROR_EX << "Unable to create sws context";
+        return;
+    }
+
+    // Encoder might still reference previous frame data
+    if (av_frame_make_writable(frame_) < 0) [[unlikely]] {
+        LOG_ERROR_EX << "Unable to make frame writable";
+        return;
+    }
+
+    const uint8_t* src_data[4] = {frame.data, nullptr, nullptr, nullptr};
+    const int src_linesize[4] = {static_cast<int>(frame.step[0]), 0, 0, 0};
+    sws_scale(sws_ctx_, src_data, src_linesize, 0, frame.rows, frame_->data, frame_->linesize);
+    frame_->pts = next_pts_++;
+    Encode(frame_);
+
+    encode_time_ += std::chrono::steady_clock::now() - start;
+    VideoWriter::AddFrame(std::move(frame));
+}
+
+bool LibavVideoWriter::Encode(const AVFrame* frame) {
+    if (!codec_ctx_ || !muxer_) [[unlikely]]
+        return false;
+
+    auto res = avcodec_send_frame(codec_ctx_, frame);
+    if (res < 0) {
+        LOG_ERROR_EX << "avcodec_send_frame() failed: " << AvErrorToString(res);
+        return false;
+    }
+
+    while (true) {
+        res = avcodec_receive_packet(codec_ctx_, packet_);
+        if (res == AVERROR(EAGAIN) || res == AVERROR_EOF)
+            return true;
+        if (res < 0) {
+            LOG_ERROR_EX << "avcodec_receive_packet() failed: " << AvErrorToString(res);
+            return false;
+        }
+        bytes_written_ += static_cast<size_t>(packet_->size);
+        muxer_->Write(*packet_);  // Packet is unreferenced by muxer
+    }
+}
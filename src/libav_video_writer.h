@@ -0,0 +1,49 @@
+#pragma once
+
+#include "segmented_muxer.h"
+#include "settings.h"
+#include "stream_properties.h"
+#include "video_writer.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// Encodes frames with libavcodec, which gives control over encoder options (preset, crf, threads, gop, pixel format)
+class LibavVideoWriter final : public VideoWriter {
+public:
+    LibavVideoWriter(const Settings& settings, const StreamProperties& out_properties);
+    ~LibavVideoWriter();
+
+    LibavVideoWriter(const LibavVideoWriter&) = delete;
+    LibavVideoWriter(LibavVideoWriter&&) = delete;
+    LibavVideoWriter& operator=(const LibavVideoWriter&) = delete;
+    LibavVideoWriter& operator=(LibavVideoWriter&&) = delete;
+
+    void AddFrame(cv::Mat frame) override;
+    bool SetPartFinishedCallback(PartFinishedCallback callback) override;
+
+private:
+    void OpenEncoder(const Settings::LibavWriterSettings& settings, const StreamProperties& out_properties, bool global_header);
+    bool Encode(const AVFrame* frame);  // nullptr - flush encoder
+    void Close();
+
+    AVCodecContext* codec_ctx_{nullptr};
+    SwsContext* sws_ctx_{nullptr};
+    AVFrame* frame_{nullptr};
+    AVPacket* packet_{nullptr};
+    std::unique_ptr<SegmentedMuxer> muxer_;
+    AVRational time_base_{1, 25};
+    int64_t next_pts_{0};
+
+    // Encoder performance stats
+    std::chrono::steady_clock::duration encode_time_{};
+    size_t bytes_written_{0};
+};
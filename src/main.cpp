@@ -1,6 +1,7 @@
 #include "core.h"
 #include "final_action.h"
 #include "log.h"
+#include "metrics.h"
 #include "ring_buffer.h"
 #include "safe_ptr.h"
 #include "settings.h"
@@ -15,6 +16,7 @@ LogLevel kAppLogLevel{LogLevel::kInfo};
 std::ostream* kAppLogStream{nullptr};
 constexpr size_t kLogTailLines{32};
 SafePtr<RingBuffer<std::string>> AppLogTail{kLogTailLines};
+SafePtr<Metrics> AppMetrics{};
 constexpr auto kSettingsFileName{"settings.json"};
 std::chrono::time_point<std::chrono::steady_clock> kStartTime{std::chrono::steady_clock::now()};
 
@@ -0,0 +1,25 @@
+#include "metrics.h"
+
+#include <format>
+
+void Metrics::Set(const std::string& name, double value) {
+    values_[name] = value;
+}
+
+void Metrics::Add(const std::string& name, double value) {
+    values_[name] += value;
+}
+
+double Metrics::Get(const std::string& name) const {
+    const auto it = values_.find(name);
+    return it == values_.end() ? 0.0 : it->second;
+}
+
+std::vector<std::string> Metrics::Dump() const {
+    std::vector<std::string> lines;
+    lines.reserve(values_.size());
+    for (const auto& [name, value] : values_) {
+        lines.push_back(std::format("{} = {:.3f}\n", name, value));
+    }
+    return lines;
+}
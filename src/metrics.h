@@ -0,0 +1,22 @@
+#pragma once
+
+#include "safe_ptr.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Named numeric values, exported via telegram '/metrics' admin command
+class Metrics final {
+public:
+    void Set(const std::string& name, double value);
+    void Add(const std::string& name, double value = 1.0);
+    double Get(const std::string& name) const;
+
+    std::vector<std::string> Dump() const;
+
+private:
+    std::map<std::string, double> values_;
+};
+
+extern SafePtr<Metrics> AppMetrics;
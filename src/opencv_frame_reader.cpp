@@ -0,0 +1,75 @@
+#include "opencv_frame_reader.h"
+
+#include "log.h"
+
+OpenCvFrameReader::OpenCvFrameReader(std::string source)
+    : source_(std::move(source))
+    , capture_(std::make_unique<cv::VideoCapture>())  {
+}
+
+bool OpenCvFrameReader::Open() {
+    capture_->release();
+    const auto res = capture_->open(source_, cv::CAP_ANY);
+    LOG_INFO_EX << "OpenCvFrameReader::Open(): " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    if (!res)
+        LOG_ERROR_EX << "OpenCvFrameReader::Open() error: " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    return res;
+}
+
+bool OpenCvFrameReader::Reconnect() {
+    capture_->release();
+    const auto res = capture_->open(source_, cv::CAP_ANY);
+    LOG_INFO_EX << "OpenCvFrameReader::Reconnect(): " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    if (!res)
+        LOG_ERROR_EX << "OpenCvFrameReader::Reconnect() error: " << LOG_VAR(res) << " for source \"" + source_ + "\"";
+    return res;
+}
+
+bool OpenCvFrameReader::GetFrame(cv::Mat& frame) {
+    // TODO: check capture_->isOpened() ? Consider performance - this function is called from tight loop
+    const auto res = capture_->read(frame);
+    LOG_TRACE_EX << "OpenCvFrameReader::GetFrame(): " << LOG_VAR(res);
+    if (!res)
+        LOG_ERROR_EX << "OpenCvFrameReader::GetFrame() error: " << LOG_VAR(res);
+    return res;
+}
+
+bool OpenCvFrameReader::Grab() {
+    const auto res = capture_->grab();
+    LOG_TRACE_EX << "OpenCvFrameReader::Grab(): " << LOG_VAR(res);
+    if (!res)
+        LOG_ERROR_EX << "OpenCvFrameReader::Grab() error: " << LOG_VAR(res);
+    return res;
+}
+
+bool OpenCvFrameReader::Retrieve(cv::Mat& frame) {
+    const auto res = capture_->retrieve(frame);
+    LOG_TRACE_EX << "OpenCvFrameReader::Retrieve(): " << LOG_VAR(res);
+    if (!res)
+        LOG_ERROR_EX << "OpenCvFrameReader::Retrieve() error: " << LOG_VAR(res);
+    return res;
+}
+
+std::chrono::milliseconds OpenCvFrameReader::GetFramePts() const {
+    return std::chrono::milliseconds(static_cast<int64_t>(capture_->get(cv::CAP_PROP_POS_MSEC)));
+}
+
+StreamProperties OpenCvFrameReader::GetStreamProperties() const {
+    if (stream_properties_)
+        return *stream_properties_;
+
+    LOG_INFO << "Fill stream properties";
+
+    stream_properties_ = StreamProperties();
+
+    stream_properties_->fps = capture_->get(cv::CAP_PROP_FPS);
+    LOG_INFO << "Obtained stream FPS: " << stream_properties_->fps;
+
+    stream_properties_->width = static_cast<int>(capture_->get(cv::CAP_PROP_FRAME_WIDTH));
+    LOG_INFO << "Obtained stream frame width: " << stream_properties_->width;
+
+    stream_properties_->height = static_cast<int>(capture_->get(cv::CAP_PROP_FRAME_HEIGHT));
+    LOG_INFO << "Obtained stream frame height: " << stream_properties_->height;
+
+    return *stream_properties_;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "frame_reader.h"
+#include "stream_properties.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>
+#include <optional>
+#include <string>
+
+class OpenCvFrameReader final : public FrameReader {
+public:
+    explicit OpenCvFrameReader(std::string source);
+
+    bool Open() override;
+    bool Reconnect() override;
+
+    bool GetFrame(cv::Mat& frame) override;
+    bool Grab() override;
+    bool Retrieve(cv::Mat& frame) override;
+
+    StreamProperties GetStreamProperties() const override;
+    std::chrono::milliseconds GetFramePts() const override;
+
+private:
+    const std::string source_;
+    std::unique_ptr<cv::VideoCapture> capture_;
+    mutable std::optional<StreamProperties> stream_properties_;
+};
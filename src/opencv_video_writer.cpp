@@ -3,32 +3,106 @@
 #include "log.h"
 #include "uid_utils.h"
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
+constexpr double kPartSizeMargin = 0.9;  // File size is checked periodically, and encoder buffers some data
+
 OpenCvVideoWriter::OpenCvVideoWriter(const Settings& settings, const StreamProperties& in_properties, const StreamProperties& out_properties)
     : VideoWriter(settings)
     , use_scale_(in_properties != out_properties)
     , scale_height_(out_properties.height / static_cast<float>(in_properties.height))
     , scale_width_(out_properties.width / static_cast<float>(in_properties.width))
-    , scale_algorithm_(scale_width_ < 1.0 ? cv::INTER_AREA : cv::INTER_LANCZOS4) {
-    const auto file_name = GenerateFileName(kVideoFilePrefix, &uid_) + kVideoFileExtension;
+    , scale_algorithm_(scale_width_ < 1.0 ? cv::INTER_AREA : cv::INTER_LANCZOS4)
+    , storage_path_(settings.storage_path)
+    , out_properties_(out_properties)
+    , max_part_size_bytes_(settings.max_video_part_size_bytes)
+    , max_part_frames_(static_cast<size_t>(std::chrono::duration<double>(settings.max_video_part_duration).count() * out_properties.fps))
+    , first_part_frames_(static_cast<size_t>(std::chrono::duration<double>(settings.early_video_part_duration).count() * out_properties.fps)) {
     if (kVideoCodec.size() != 4) {
         const auto msg = "Invalid codec specified: " + kVideoCodec;
         LOG_ERROR_EX << msg;
         throw std::runtime_error(msg);
     }
 
+    GenerateFileName(kVideoFilePrefix, &uid_);
+    OpenPart();
+    LOG_INFO << "Video writer opened file with uid = " << uid_;
+}
+
+OpenCvVideoWriter::~OpenCvVideoWriter() {
+    ClosePart();
+    const auto duration_s = out_properties_.fps > 0.0 ? static_cast<double>(frames_written_) / out_properties_.fps : 0.0;
+    ReportStats("opencv", frames_written_, encode_time_, duration_s, bytes_written_);
+}
+
+bool OpenCvVideoWriter::SetPartFinishedCallback(PartFinishedCallback callback) {
+    part_finished_callback_ = std::move(callback);
+    return true;
+}
+
+void OpenCvVideoWriter::ClosePart() {
+    if (!writer_.isOpened())
+        return;
+    writer_.release();
+
+    const auto file_path = storage_path_ / GeneratePartFileName(uid_, part_number_);
+    std::error_code ec;
+    if (const auto size = std::filesystem::file_size(file_path, ec); !ec)
+        bytes_written_ += static_cast<size_t>(size);
+    if (part_finished_callback_)
+        part_finished_callback_(file_path, part_number_);
+}
+
+void OpenCvVideoWriter::OpenPart() {
+    // Part number is advanced only when the part is opened, so part files are numbered without gaps
+    const auto file_name = GeneratePartFileName(uid_, part_number_ + 1);
     const auto four_cc = cv::VideoWriter::fourcc(kVideoCodec[0], kVideoCodec[1], kVideoCodec[2], kVideoCodec[3]);
-    if (!writer_.open((settings.storage_path / file_name).generic_string(), four_cc, out_properties.fps, cv::Size(out_properties.width, out_properties.height))) {
+    if (!writer_.open((storage_path_ / file_name).generic_string(), four_cc, out_properties_.fps, cv::Size(out_properties_.width, out_properties_.height))) {
         const auto msg = "Unable to open file for writing: " + file_name;
-        LOG_ERROR_EX << msg;
+        if (!open_failed_)
+            LOG_ERROR_EX << msg;
         throw std::runtime_error(msg);
     }
-    LOG_INFO << "Video writer opened file with uid = " << uid_;
-    
+    ++part_number_;
+    part_frames_ = 0;
+    if (part_number_ > 1)
+        LOG_INFO << "Video part " << part_number_ << " started, uid = " << uid_;
+}
+
+bool OpenCvVideoWriter::NeedsNewPart() {
+    const auto max_frames = part_number_ == 1 && first_part_frames_ > 0 ? first_part_frames_ : max_part_frames_;
+    if (max_frames > 0 && part_frames_ >= max_frames)
+        return true;
+
+    // File size is checked about once a second
+    const auto size_check_interval = std::max<size_t>(1, static_cast<size_t>(out_properties_.fps));
+    if (max_part_size_bytes_ > 0 && part_frames_ > 0 && part_frames_ % size_check_interval == 0) {
+        std::error_code ec;
+        const auto size = std::filesystem::file_size(storage_path_ / GeneratePartFileName(uid_, part_number_), ec);
+        if (!ec && static_cast<double>(size) >= static_cast<double>(max_part_size_bytes_) * kPartSizeMargin)
+            return true;
+    }
+    return false;
 }
 
 void OpenCvVideoWriter::AddFrame(cv::Mat frame) {
+    // Failed part is opened again with the next frame, frames are dropped meanwhile
+    if (!writer_.isOpened() || NeedsNewPart()) {
+        ClosePart();
+        try {
+            OpenPart();
+            open_failed_ = false;
+        } catch (std::exception& e) {
+            if (!open_failed_)
+                LOG_EXCEPTION("Unable to open video part file, frames are dropped till it's opened", e);
+            open_failed_ = true;
+            return;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
     if (use_scale_) {
         cv::Mat resized_frame;
         cv::resize(frame, resized_frame, cv::Size(0, 0), scale_width_, scale_height_, scale_algorithm_);
@@ -36,5 +110,8 @@ void OpenCvVideoWriter::AddFrame(cv::Mat frame) {
     } else {
         writer_.write(frame);
     }
+    encode_time_ += std::chrono::steady_clock::now() - start;
+    ++part_frames_;
+    ++frames_written_;
     VideoWriter::AddFrame(std::move(frame));
 }
@@ -6,16 +6,41 @@
 
 #include <opencv2/opencv.hpp>
 
+#include <chrono>
+#include <filesystem>
+
 class OpenCvVideoWriter : public VideoWriter {
 public:
     OpenCvVideoWriter(const Settings& settings, const StreamProperties& in_properties, const StreamProperties& out_properties);
+    ~OpenCvVideoWriter();
 
     void AddFrame(cv::Mat frame) override;
+    bool SetPartFinishedCallback(PartFinishedCallback callback) override;
 
 private:
+    void OpenPart();
+    void ClosePart();
+    bool NeedsNewPart();
+
     cv::VideoWriter writer_;
     const bool use_scale_{false};
     const double scale_height_{1.0};
     const double scale_width_{1.0};
     const int scale_algorithm_{cv::INTER_AREA};
+
+    // Video is split into parts at write time. Encoder is restarted for each part, so every part starts from keyframe
+    const std::filesystem::path storage_path_;
+    const StreamProperties out_properties_;
+    const size_t max_part_size_bytes_{0};
+    const size_t max_part_frames_{0};
+    const size_t first_part_frames_{0};  // Short first part allows to send the beginning of event early
+    PartFinishedCallback part_finished_callback_;
+    size_t part_number_{0};
+    size_t part_frames_{0};
+    bool open_failed_{false};  // Error is logged once, while opening is retried for every frame
+
+    // Encoder performance stats
+    std::chrono::steady_clock::duration encode_time_{};
+    size_t frames_written_{0};
+    size_t bytes_written_{0};  // Of closed parts
 };
@@ -0,0 +1,112 @@
+#include "passthrough_video_writer.h"
+
+#include "log.h"
+#include "uid_utils.h"
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+#include <algorithm>
+
+namespace {
+
+struct AvPacketDeleter {
+    void operator()(AVPacket* packet) const {
+        av_packet_free(&packet);
+    }
+};
+using AvPacketPtr = std::unique_ptr<AVPacket, AvPacketDeleter>;
+
+}  // namespace
+
+PassthroughVideoWriter::PassthroughVideoWriter(const Settings& settings, std::string file_prefix)
+    : VideoWriter(settings)
+    , settings_(settings)
+    , file_prefix_(std::move(file_prefix)) {
+    GenerateFileName(file_prefix_, &uid_);
+    LOG_INFO << "Passthrough video writer created, uid = " << uid_ << ", waiting for keyframe";
+}
+
+PassthroughVideoWriter::~PassthroughVideoWriter() {
+    if (!muxer_) {
+        LOG_WARNING_EX << "No keyframe received, file with uid = " << uid_ << " is not written";
+        return;
+    }
+    LOG_INFO << "Passthrough video writer finished, uid = " << uid_ << ", " << LOG_VAR(packets_written_) << ", "
+             << LOG_VAR(packets_skipped_);
+
+    const AVRational time_base{stream_info_->time_base_num, stream_info_->time_base_den};
+    const auto duration_s = static_cast<double>(last_dts_ + frame_duration_) * av_q2d(time_base);
+    // Continuous recording segments are reported separately from event videos
+    ReportStats(file_prefix_ == kVideoFilePrefix ? "passthrough" : "passthrough_continuous", packets_written_, write_time_, duration_s, bytes_written_);
+}
+
+void PassthroughVideoWriter::OpenMuxer(const EncodedStreamInfo& stream_info) {
+    const AVRational time_base{stream_info.time_base_num, stream_info.time_base_den};
+    muxer_ = std::make_unique<SegmentedMuxer>(settings_, file_prefix_, uid_, *stream_info.codec_parameters, time_base);
+    muxer_->SetPartFinishedCallback(part_finished_callback_);
+    if (stream_info.fps > 0.0)
+        frame_duration_ = std::max<int64_t>(1, av_rescale_q(1, av_inv_q(av_d2q(stream_info.fps, 100'000)), time_base));
+    LOG_INFO << "Video writer opened file with uid = " << uid_;
+}
+
+bool PassthroughVideoWriter::SetPartFinishedCallback(PartFinishedCallback callback) {
+    part_finished_callback_ = std::move(callback);
+    if (muxer_)
+        muxer_->SetPartFinishedCallback(part_finished_callback_);
+    return true;
+}
+
+void PassthroughVideoWriter::AddPacket(const EncodedPacket& packet) {
+    if (!muxer_) {
+        if (!packet.key_frame) {
+            ++packets_skipped_;
+            return;
+        }
+        OpenMuxer(*packet.stream);
+        stream_info_ = packet.stream;
+        const auto* first = packet.packet.get();
+        ts_offset_ = first->dts != AV_NOPTS_VALUE ? first->dts : (first->pts != AV_NOPTS_VALUE ? first->pts : 0);
+        last_dts_ = -frame_duration_;
+    } else if (packet.stream != stream_info_) [[unlikely]] {
+        // Stream parameters are changed on reconnect, packets can't be written into the same file
+        if (packets_skipped_++ == 0 || packet.key_frame)
+            LOG_WARNING_EX << "Stream parameters changed while writing file with uid = " << uid_ << ", packet skipped";
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    AvPacketPtr out(av_packet_clone(packet.packet.get()));
+    if (!out) [[unlikely]] {
+        LOG_ERROR_EX << "Unable to clone packet";
+        return;
+    }
+
+    if (out->pts == AV_NOPTS_VALUE && out->dts == AV_NOPTS_VALUE) {
+        out->dts = last_dts_ + frame_duration_ + ts_offset_;
+        out->pts = out->dts;
+    } else if (out->dts == AV_NOPTS_VALUE) {
+        out->dts = out->pts;
+    } else if (out->pts == AV_NOPTS_VALUE) {
+        out->pts = out->dts;
+    }
+    out->pts -= ts_offset_;
+    out->dts -= ts_offset_;
+
+    // Source timestamps may jump back (e. g. after reconnect), keep them monotonic for muxer
+    if (out->dts <= last_dts_) {
+        const auto shift = last_dts_ + frame_duration_ - out->dts;
+        ts_offset_ -= shift;
+        out->dts += shift;
+        out->pts += shift;
+    }
+    last_dts_ = out->dts;
+
+    const auto size = static_cast<size_t>(out->size);
+    if (muxer_->Write(*out)) {
+        ++packets_written_;
+        bytes_written_ += size;
+    }
+    write_time_ += std::chrono::steady_clock::now() - start;
+}
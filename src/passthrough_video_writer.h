@@ -0,0 +1,44 @@
+#pragma once
+
+#include "encoded_packet.h"
+#include "segmented_muxer.h"
+#include "settings.h"
+#include "video_writer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Remuxes compressed packets of the source stream into file, without decoding and encoding.
+// Recording starts from keyframe, preview images are sampled from frames passed to AddFrame()
+class PassthroughVideoWriter final : public VideoWriter {
+public:
+    explicit PassthroughVideoWriter(const Settings& settings, std::string file_prefix = kVideoFilePrefix);
+    ~PassthroughVideoWriter();
+
+    void AddPacket(const EncodedPacket& packet) override;
+    bool SetPartFinishedCallback(PartFinishedCallback callback) override;
+
+    bool NeedsFrames() const override { return false; }
+    bool NeedsPackets() const override { return true; }
+
+private:
+    void OpenMuxer(const EncodedStreamInfo& stream_info);
+
+    const Settings settings_;
+    const std::string file_prefix_;
+    PartFinishedCallback part_finished_callback_;
+    std::unique_ptr<SegmentedMuxer> muxer_;
+    std::shared_ptr<const EncodedStreamInfo> stream_info_;
+
+    int64_t ts_offset_{0};  // Timestamps are rebased to start from zero
+    int64_t last_dts_{0};
+    int64_t frame_duration_{1};
+    size_t packets_written_{0};
+    size_t packets_skipped_{0};  // Packets before the first keyframe or with changed stream parameters
+
+    // Remuxing performance stats, reported as encoder ones to compare with encoding writers
+    std::chrono::steady_clock::duration write_time_{};
+    size_t bytes_written_{0};
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iterator>
+#include <vector>
+
+// Keeps the last items (compressed packets or encoded frames) for the specified duration, bounded by size in bytes.
+// Buffer always starts from key item, so its content can be written into a new file as is
+template <typename T>
+class PreEventBuffer final {
+public:
+    struct Entry {
+        T item;
+        std::chrono::steady_clock::time_point timestamp;
+        size_t size_bytes{0};
+    };
+
+    PreEventBuffer(std::chrono::milliseconds duration, size_t max_size_bytes)
+        : duration_(duration)
+        , max_size_bytes_(max_size_bytes) {}
+
+    void Push(T item, size_t size_bytes, bool key, std::chrono::steady_clock::time_point timestamp = std::chrono::steady_clock::now()) {
+        if (key) {
+            groups_.emplace_back();
+        } else if (groups_.empty()) {
+            return;  // Nothing to decode this item with
+        }
+
+        auto& group = groups_.back();
+        group.entries.push_back({std::move(item), timestamp, size_bytes});
+        group.size_bytes += size_bytes;
+        size_bytes_ += size_bytes;
+        Trim(timestamp);
+    }
+
+    // Returns buffered items in order, buffer is cleared
+    std::vector<Entry> Take() {
+        std::vector<Entry> result;
+        for (auto& group : groups_) {
+            std::move(begin(group.entries), end(group.entries), std::back_inserter(result));
+        }
+        groups_.clear();
+        size_bytes_ = 0;
+        return result;
+    }
+
+    bool Empty() const {
+        return groups_.empty();
+    }
+
+    size_t SizeBytes() const {
+        return size_bytes_;
+    }
+
+private:
+    struct Group {  // Key item and the following items depending on it
+        std::vector<Entry> entries;
+        size_t size_bytes{0};
+    };
+
+    void Trim(std::chrono::steady_clock::time_point now) {
+        // The oldest group is dropped only if the rest still covers the duration
+        while (groups_.size() > 1 && groups_[1].entries.front().timestamp <= now - duration_) {
+            PopFront();
+        }
+        // Size limit is strict, so even the only group might be dropped
+        while (size_bytes_ > max_size_bytes_ && !groups_.empty()) {
+            PopFront();
+        }
+    }
+
+    void PopFront() {
+        size_bytes_ -= groups_.front().size_bytes;
+        groups_.pop_front();
+    }
+
+    const std::chrono::milliseconds duration_;
+    const size_t max_size_bytes_;
+    std::deque<Group> groups_;
+    size_t size_bytes_{0};
+};
@@ -0,0 +1,98 @@
+#include "qos_controller.h"
+
+#include "log.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double kIntervalIncreaseFactor = 1.5;
+constexpr double kScaleDecreaseFactor = 0.8;
+
+QosController::QosController(const Settings& settings)
+    : enabled_(settings.qos_settings.enabled)
+    , min_detect_interval_(std::max(settings.nth_detect_frame, 1))
+    , max_detect_interval_(std::max(settings.qos_settings.max_nth_detect_frame, min_detect_interval_))
+    , min_scale_(std::clamp(settings.qos_settings.min_scale, 0.1, 1.0))
+    , target_buffer_size_(settings.qos_settings.target_buffer_size)
+    , cpu_budget_(settings.qos_settings.cpu_budget)
+    , max_detect_latency_(settings.qos_settings.max_detect_latency)
+    , adjust_interval_(settings.qos_settings.adjust_interval)
+    , detect_interval_(min_detect_interval_) {
+}
+
+int QosController::GetDetectInterval() const {
+    return detect_interval_.load(std::memory_order_relaxed);
+}
+
+double QosController::GetScale() const {
+    return scale_.load(std::memory_order_relaxed);
+}
+
+void QosController::OnDetect(std::chrono::steady_clock::duration latency, size_t buffer_size) {
+    window_busy_ += latency;
+    ++window_detects_;
+    window_max_buffer_size_ = std::max(window_max_buffer_size_, buffer_size);
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto window = now - window_start_;
+    if (window < adjust_interval_)
+        return;
+
+    const double busy_ratio = static_cast<double>(window_busy_.count()) / static_cast<double>(window.count());
+    const auto avg_latency = std::chrono::duration_cast<std::chrono::milliseconds>(window_busy_ / window_detects_);
+
+    if (enabled_)
+        Adjust(busy_ratio, avg_latency);
+    ExportMetrics(busy_ratio, avg_latency);
+
+    window_start_ = now;
+    window_busy_ = {};
+    window_detects_ = 0;
+    window_max_buffer_size_ = 0;
+}
+
+void QosController::Adjust(double busy_ratio, std::chrono::milliseconds avg_latency) {
+    const bool latency_exceeded = max_detect_latency_.count() > 0 && avg_latency > max_detect_latency_;
+    const bool overloaded = window_max_buffer_size_ > target_buffer_size_ || busy_ratio > cpu_budget_ || latency_exceeded;
+    const bool underloaded = window_max_buffer_size_ <= target_buffer_size_ / 4 && busy_ratio < cpu_budget_ / 2
+                             && (max_detect_latency_.count() == 0 || avg_latency < max_detect_latency_ / 2);
+
+    const auto interval = GetDetectInterval();
+    const auto scale = GetScale();
+    auto new_interval = interval;
+    auto new_scale = scale;
+
+    if (overloaded) {
+        if (interval < max_detect_interval_) {
+            new_interval = std::min(max_detect_interval_, static_cast<int>(std::ceil(interval * kIntervalIncreaseFactor)));
+        } else if (scale > min_scale_) {
+            new_scale = std::max(min_scale_, scale * kScaleDecreaseFactor);
+        }
+    } else if (underloaded) {
+        if (scale < 1.0) {
+            new_scale = std::min(1.0, scale / kScaleDecreaseFactor);
+        } else if (interval > min_detect_interval_) {
+            new_interval = std::max(min_detect_interval_, static_cast<int>(interval / kIntervalIncreaseFactor));
+        }
+    }
+
+    if (new_interval == interval && new_scale == scale)
+        return;
+
+    LOG_INFO << "QoS adjustment: detect interval " << interval << " -> " << new_interval << ", scale " << scale
+             << " -> " << new_scale << " (max buffer size = " << window_max_buffer_size_ << ", busy ratio = " << busy_ratio
+             << ", avg detect latency = " << avg_latency.count() << " ms)";
+
+    detect_interval_.store(new_interval, std::memory_order_relaxed);
+    scale_.store(new_scale, std::memory_order_relaxed);
+    AppMetrics->Add("qos_adjustments");
+}
+
+void QosController::ExportMetrics(double busy_ratio, std::chrono::milliseconds avg_latency) const {
+    AppMetrics->Set("qos_detect_interval", GetDetectInterval());
+    AppMetrics->Set("qos_scale", GetScale());
+    AppMetrics->Set("qos_busy_ratio", busy_ratio);
+    AppMetrics->Set("qos_avg_detect_latency_ms", static_cast<double>(avg_latency.count()));
+    AppMetrics->Set("qos_max_buffer_size", static_cast<double>(window_max_buffer_size_));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "settings.h"
+
+#include <atomic>
+#include <chrono>
+
+// Adapts detect interval and inference scale to the processing load.
+// Detect rate is decreased first, then the scale; recovery goes in reverse order
+class QosController final {
+public:
+    explicit QosController(const Settings& settings);
+
+    QosController(const QosController&) = delete;
+    QosController(QosController&&) = delete;
+    QosController& operator=(const QosController&) = delete;
+    QosController& operator=(QosController&&) = delete;
+
+    int GetDetectInterval() const;
+    double GetScale() const;  // Multiplier for img_scale_x/img_scale_y
+
+    // Called from processing thread after each detect
+    void OnDetect(std::chrono::steady_clock::duration latency, size_t buffer_size);
+
+private:
+    void Adjust(double busy_ratio, std::chrono::milliseconds avg_latency);
+    void ExportMetrics(double busy_ratio, std::chrono::milliseconds avg_latency) const;
+
+    const bool enabled_{false};
+    const int min_detect_interval_{1};
+    const int max_detect_interval_{1};
+    const double min_scale_{1.0};
+    const size_t target_buffer_size_{0};
+    const double cpu_budget_{1.0};
+    const std::chrono::milliseconds max_detect_latency_{0};
+    const std::chrono::milliseconds adjust_interval_{0};
+
+    std::atomic_int detect_interval_{1};
+    std::atomic<double> scale_{1.0};
+
+    // Statistics of the current window
+    std::chrono::steady_clock::time_point window_start_{std::chrono::steady_clock::now()};
+    std::chrono::steady_clock::duration window_busy_{};
+    size_t window_detects_{0};
+    size_t window_max_buffer_size_{0};
+};
@@ -0,0 +1,181 @@
+#include "recordings_index.h"
+
+#include "log.h"
+#include "uid_utils.h"
+#include "video_writer.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <regex>
+
+const std::string kRecordingsIndexFileName = "recordings.jsonl";
+
+namespace {
+
+int64_t ToSeconds(RecordingsIndex::TimePoint tp) {
+    return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+}
+
+nlohmann::json ToJson(const RecordingsIndex::Recording& recording) {
+    return nlohmann::json{
+        {"uid", recording.uid},
+        {"ts", ToSeconds(recording.timestamp)},
+        {"size", recording.size_bytes},
+        {"duration_ms", recording.duration.count()},
+        {"parts", recording.part_files},
+        {"classes", recording.classes}
+    };
+}
+
+RecordingsIndex::Recording FromJson(const nlohmann::json& json) {
+    return RecordingsIndex::Recording{
+        json.at("uid"),
+        RecordingsIndex::TimePoint(std::chrono::seconds(json.at("ts").get<int64_t>())),
+        json.at("size"),
+        std::chrono::milliseconds(json.at("duration_ms").get<int64_t>()),
+        json.at("parts"),
+        json.at("classes")
+    };
+}
+
+size_t GetPartNumber(const std::filesystem::path& file_path) {
+    // The main file is the first part
+    static const auto part_regex = std::regex(VideoWriter::kVideoPartSuffix + R"((\d+)$)");
+    std::smatch match;
+    const auto stem = file_path.stem().generic_string();
+    if (std::regex_search(stem, match, part_regex))
+        return std::stoul(match[1].str());
+    return 0;
+}
+
+}  // namespace
+
+RecordingsIndex::RecordingsIndex(std::filesystem::path storage_path)
+    : storage_path_(std::move(storage_path))
+    , index_file_path_(storage_path_ / kRecordingsIndexFileName) {
+    if (std::filesystem::exists(index_file_path_)) {
+        Load();
+    } else {
+        Rebuild();
+    }
+    Save();
+    index_file_.open(index_file_path_, std::ios::app);
+    if (!index_file_)
+        LOG_ERROR_EX << "Unable to open recordings index file " << index_file_path_ << ", index is kept in memory only";
+}
+
+void RecordingsIndex::Load() {
+    std::ifstream in(index_file_path_);
+    std::string line;
+    size_t invalid_lines = 0;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        try {
+            const auto json = nlohmann::json::parse(line);
+            if (json.value("removed", false)) {
+                Erase(json.at("uid"));
+            } else {
+                Insert(FromJson(json));
+            }
+        } catch (std::exception&) {
+            ++invalid_lines;  // E. g. the last line is not completely written
+        }
+    }
+    if (invalid_lines > 0)
+        LOG_WARNING << "Recordings index has invalid lines, " << LOG_VAR(invalid_lines);
+    LOG_INFO << "Recordings index loaded, recordings = " << recordings_.size();
+}
+
+void RecordingsIndex::Rebuild() {
+    LOG_INFO << "Recordings index is missing, rebuild from storage";
+    std::map<std::string, std::vector<std::pair<size_t, std::filesystem::path>>> files;  // By uid
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(storage_path_, ec)) {
+        const auto& path = entry.path();
+        if (!entry.is_regular_file() || path.extension() != VideoWriter::kVideoFileExtension
+            || !path.filename().generic_string().starts_with(VideoWriter::kVideoFilePrefix)) {
+            continue;
+        }
+        files[GetUidFromFileName(path.filename().generic_string())].emplace_back(GetPartNumber(path), path);
+    }
+    if (ec)
+        LOG_ERROR_EX << "Unable to scan storage: " << ec.message();
+
+    for (auto& [uid, parts] : files) {
+        if (!IsUidValid(uid))
+            continue;
+        std::sort(begin(parts), end(parts));
+
+        // Duration and classes are not known here
+        Recording recording{uid, GetTimestampFromUid(uid)};
+        for (const auto& [part_number, path] : parts) {
+            std::error_code size_ec;
+            const auto size = std::filesystem::file_size(path, size_ec);
+            if (!size_ec)
+                recording.size_bytes += static_cast<size_t>(size);
+            recording.part_files.push_back(path.filename().generic_string());
+        }
+        Insert(std::move(recording));
+    }
+    LOG_INFO << "Recordings index rebuilt, recordings = " << recordings_.size();
+}
+
+void RecordingsIndex::Save() {
+    std::ofstream out(index_file_path_, std::ios::trunc);
+    for (const auto& [timestamp, recording] : recordings_)
+        out << ToJson(recording).dump() << '\n';
+}
+
+void RecordingsIndex::Insert(Recording recording) {
+    Erase(recording.uid);
+    timestamps_[recording.uid] = recording.timestamp;
+    const auto timestamp = recording.timestamp;
+    recordings_.emplace(timestamp, std::move(recording));
+}
+
+void RecordingsIndex::Erase(const std::string& uid) {
+    const auto it = timestamps_.find(uid);
+    if (it == timestamps_.end())
+        return;
+
+    const auto [first, last] = recordings_.equal_range(it->second);
+    for (auto rec_it = first; rec_it != last; ++rec_it) {
+        if (rec_it->second.uid == uid) {
+            recordings_.erase(rec_it);
+            break;
+        }
+    }
+    timestamps_.erase(it);
+}
+
+void RecordingsIndex::Append(const std::string& line) {
+    if (!index_file_)
+        return;
+    index_file_ << line << '\n';
+    index_file_.flush();
+}
+
+void RecordingsIndex::Add(Recording recording) {
+    const auto line = ToJson(recording).dump();
+    std::lock_guard lock(mutex_);
+    Insert(std::move(recording));
+    Append(line);
+}
+
+void RecordingsIndex::Remove(const std::string& uid) {
+    std::lock_guard lock(mutex_);
+    if (!timestamps_.contains(uid))
+        return;
+    Erase(uid);
+    Append(nlohmann::json{{"uid", uid}, {"removed", true}}.dump());
+}
+
+std::vector<RecordingsIndex::Recording> RecordingsIndex::Find(TimePoint from, TimePoint to) const {
+    std::lock_guard lock(mutex_);
+    std::vector<Recording> result;
+    for (auto it = recordings_.lower_bound(from); it != recordings_.end() && it->first <= to; ++it)
+        result.push_back(it->second);
+    return result;
+}
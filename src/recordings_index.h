@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Persistent index of recorded event videos, so the storage is not scanned on each request. Records are appended to
+// JSON lines file when video is finalized. If index file is missing, it's rebuilt from the storage. Thread safe
+class RecordingsIndex final {
+public:
+    using TimePoint = std::chrono::system_clock::time_point;
+
+    struct Recording {
+        std::string uid;
+        TimePoint timestamp{};
+        size_t size_bytes{0};  // All parts
+        std::chrono::milliseconds duration{std::chrono::milliseconds(0)};  // 0 - unknown
+        std::vector<std::string> part_files;  // File names, the first one is the main file
+        std::vector<std::string> classes;  // Detected object classes
+    };
+
+    explicit RecordingsIndex(std::filesystem::path storage_path);
+
+    void Add(Recording recording);
+    void Remove(const std::string& uid);
+
+    std::vector<Recording> Find(TimePoint from, TimePoint to) const;  // Sorted by timestamp
+
+private:
+    void Load();
+    void Rebuild();
+    void Save();  // Rewrites compacted index file
+    void Insert(Recording recording);
+    void Erase(const std::string& uid);
+    void Append(const std::string& line);
+
+    const std::filesystem::path storage_path_;
+    const std::filesystem::path index_file_path_;
+    std::multimap<TimePoint, Recording> recordings_;
+    std::unordered_map<std::string, TimePoint> timestamps_;  // By uid
+    std::ofstream index_file_;
+    mutable std::mutex mutex_;
+};
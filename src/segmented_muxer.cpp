@@ -0,0 +1,106 @@
+#include "segmented_muxer.h"
+
+#include "log.h"
+
+extern "C" {
+#include <libavutil/mathematics.h>
+}
+
+#include <stdexcept>
+
+constexpr double kGopSizeMargin = 1.25;  // GOP sizes vary, so estimation is increased a bit
+
+SegmentedMuxer::SegmentedMuxer(const Settings& settings, std::string file_prefix, std::string uid, const AVCodecParameters& codec_parameters,
+                               AVRational time_base)
+    : storage_path_(settings.storage_path)
+    , file_prefix_(std::move(file_prefix))
+    , uid_(std::move(uid))
+    , codec_parameters_(avcodec_parameters_alloc())
+    , time_base_(time_base)
+    , max_part_size_bytes_(settings.max_video_part_size_bytes)
+    , max_part_duration_(av_rescale_q(settings.max_video_part_duration.count(), AVRational{1, 1000}, time_base))
+    , first_part_duration_(av_rescale_q(settings.early_video_part_duration.count(), AVRational{1, 1000}, time_base))
+    , fragment_duration_(settings.use_fragmented_mp4 ? settings.fragment_duration : std::chrono::milliseconds(0)) {
+    if (!codec_parameters_ || avcodec_parameters_copy(codec_parameters_, &codec_parameters) < 0) {
+        avcodec_parameters_free(&codec_parameters_);
+        static const auto err_msg = "Unable to copy codec parameters";
+        LOG_ERROR_EX << err_msg;
+        throw std::runtime_error(err_msg);
+    }
+}
+
+SegmentedMuxer::~SegmentedMuxer() {
+    ClosePart();
+    avcodec_parameters_free(&codec_parameters_);
+}
+
+bool SegmentedMuxer::NeedsNewPart(const AVPacket& key_packet) const {
+    if (!muxer_)
+        return true;
+    if (max_part_size_bytes_ > 0
+        && static_cast<double>(part_size_bytes_) + static_cast<double>(last_gop_size_bytes_) * kGopSizeMargin > static_cast<double>(max_part_size_bytes_)) {
+        return true;
+    }
+    const auto max_duration = part_number_ == 1 && first_part_duration_ > 0 ? first_part_duration_ : max_part_duration_;
+    if (max_duration > 0 && key_packet.dts - part_start_dts_ + last_gop_duration_ > max_duration)
+        return true;
+    return false;
+}
+
+void SegmentedMuxer::OpenPart(int64_t start_dts) {
+    ClosePart();
+    ++part_number_;
+    part_file_path_ = storage_path_ / VideoWriter::GeneratePartFileName(uid_, part_number_, file_prefix_);
+    try {
+        muxer_ = std::make_unique<LibavMuxer>(part_file_path_, *codec_parameters_, time_base_, fragment_duration_);
+    } catch (std::exception& e) {
+        LOG_EXCEPTION("Unable to open video part file", e);  // Next keyframe will try again
+        --part_number_;
+        return;
+    }
+    part_start_dts_ = start_dts;
+    part_size_bytes_ = 0;
+    LOG_INFO << "Video part " << part_number_ << " started, uid = " << uid_;
+}
+
+void SegmentedMuxer::ClosePart() {
+    if (!muxer_)
+        return;
+
+    muxer_.reset();
+    if (max_part_size_bytes_ > 0 && part_size_bytes_ > max_part_size_bytes_) {
+        LOG_WARNING << "Video part " << part_number_ << " exceeds size limit, uid = " << uid_ << ", "
+                    << LOG_VAR(part_size_bytes_) << ". Keyframe interval of the source might be too long";
+    }
+    if (part_finished_callback_)
+        part_finished_callback_(part_file_path_, part_number_);
+}
+
+void SegmentedMuxer::SetPartFinishedCallback(VideoWriter::PartFinishedCallback callback) {
+    part_finished_callback_ = std::move(callback);
+}
+
+bool SegmentedMuxer::Write(AVPacket& packet) {
+    if (packet.flags & AV_PKT_FLAG_KEY) {
+        if (gop_size_bytes_ > 0) {
+            last_gop_size_bytes_ = gop_size_bytes_;
+            last_gop_duration_ = packet.dts - gop_start_dts_;
+        }
+        gop_start_dts_ = packet.dts;
+        gop_size_bytes_ = 0;
+        if (NeedsNewPart(packet))
+            OpenPart(packet.dts);
+    }
+
+    if (!muxer_) {
+        av_packet_unref(&packet);
+        return false;
+    }
+
+    const auto size = static_cast<size_t>(packet.size);
+    gop_size_bytes_ += size;
+    part_size_bytes_ += size;
+    packet.dts -= part_start_dts_;
+    packet.pts -= part_start_dts_;
+    return muxer_->Write(packet);
+}
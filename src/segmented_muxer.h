@@ -0,0 +1,63 @@
+#pragma once
+
+#include "libav_muxer.h"
+#include "settings.h"
+#include "video_writer.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+// Writes packets into sequence of video part files. New part is started at keyframe, if the next GOP is expected to
+// exceed size or duration limit, so each part is ready to be sent as is. Timestamps of each part start from zero
+class SegmentedMuxer final {
+public:
+    SegmentedMuxer(const Settings& settings, std::string file_prefix, std::string uid, const AVCodecParameters& codec_parameters,
+                   AVRational time_base);
+    ~SegmentedMuxer();
+
+    SegmentedMuxer(const SegmentedMuxer&) = delete;
+    SegmentedMuxer(SegmentedMuxer&&) = delete;
+    SegmentedMuxer& operator=(const SegmentedMuxer&) = delete;
+    SegmentedMuxer& operator=(SegmentedMuxer&&) = delete;
+
+    // Packet timestamps are expected in time base passed to constructor. Packets before the first keyframe are skipped
+    bool Write(AVPacket& packet);
+
+    // Callback is called when part file is closed, including the last one
+    void SetPartFinishedCallback(VideoWriter::PartFinishedCallback callback);
+
+private:
+    bool NeedsNewPart(const AVPacket& key_packet) const;
+    void OpenPart(int64_t start_dts);
+    void ClosePart();
+
+    const std::filesystem::path storage_path_;
+    const std::string file_prefix_;
+    const std::string uid_;
+    AVCodecParameters* codec_parameters_{nullptr};
+    const AVRational time_base_;
+    const size_t max_part_size_bytes_;  // 0 - not limited
+    const int64_t max_part_duration_;  // In time base units, 0 - not limited
+    const int64_t first_part_duration_;  // Short first part allows to send the beginning of event early
+    const std::chrono::milliseconds fragment_duration_;
+    VideoWriter::PartFinishedCallback part_finished_callback_;
+
+    std::unique_ptr<LibavMuxer> muxer_;
+    size_t part_number_{0};
+    std::filesystem::path part_file_path_;
+    int64_t part_start_dts_{0};
+    size_t part_size_bytes_{0};
+
+    // The last complete GOP is used as an estimation of the next one
+    int64_t gop_start_dts_{0};
+    size_t gop_size_bytes_{0};
+    size_t last_gop_size_bytes_{0};
+    int64_t last_gop_duration_{0};
+};
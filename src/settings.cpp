@@ -4,6 +4,7 @@
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
@@ -20,6 +21,21 @@ const std::map<std::string, DetectionEngine> kStrToDetectionEngine = {
     {"HYBRIDOPENCV", DetectionEngine::kHybridOpenCv},
 };
 
+const std::map<std::string, VideoWriterType> kStrToVideoWriterType = {
+    {"OPENCV", VideoWriterType::kOpenCv},
+    {"FFMPEG", VideoWriterType::kFfmpeg},
+    {"PASSTHROUGH", VideoWriterType::kPassthrough},
+    {"LIBAV", VideoWriterType::kLibav}
+};
+
+const std::map<std::string, StoredFileType> kStrToStoredFileType = {
+    {"VIDEO", StoredFileType::kVideo},
+    {"CONTINUOUS", StoredFileType::kContinuous},
+    {"PREVIEW", StoredFileType::kPreview},
+    {"ALARM", StoredFileType::kAlarmPhoto},
+    {"ONDEMAND", StoredFileType::kOnDemandPhoto}
+};
+
 namespace {
 
 BufferOverflowStrategy StringToBufferStrategy(const std::string& str) {
@@ -36,6 +52,20 @@ DetectionEngine StringToDetectionEngine(const std::string& str) {
     return it->second;
 }
 
+VideoWriterType StringToVideoWriterType(const std::string& str) {
+    const auto it = kStrToVideoWriterType.find(ToUpper(str));
+    if (it == end(kStrToVideoWriterType))
+        throw std::runtime_error("Unknown video writer string specified");
+    return it->second;
+}
+
+StoredFileType StringToStoredFileType(const std::string& str) {
+    const auto it = kStrToStoredFileType.find(ToUpper(str));
+    if (it == end(kStrToStoredFileType))
+        throw std::runtime_error("Unknown stored file type string specified");
+    return it->second;
+}
+
 }  // namespace
 
 Settings LoadSettings(const std::string& settings_file_name) {
@@ -48,6 +78,20 @@ Settings LoadSettings(const std::string& settings_file_name) {
     }
 
     settings.source = json.at("source");  // Mandatory options are obtained like this - throwable
+    settings.detect_source = json.value("detect_source", settings.detect_source);
+    settings.use_libav_reader = json.value("use_libav_reader", settings.use_libav_reader);
+    if (json.contains("libav_reader_settings")) {
+        const auto libav_reader_settings = json["libav_reader_settings"];
+        settings.libav_reader_settings = {
+            libav_reader_settings.at("rtsp_transport"),
+            libav_reader_settings.at("probe_size"),
+            std::chrono::milliseconds(libav_reader_settings.at("analyze_duration_ms")),
+            libav_reader_settings.at("decoder_threads"),
+            std::chrono::milliseconds(libav_reader_settings.at("timeout_ms")),
+            libav_reader_settings.at("low_delay"),
+            libav_reader_settings.at("reorder_queue_size")
+        };
+    }
     settings.storage_path = json.at("storage_path").get<std::string>();
     settings.errors_before_reconnect = json.value("errors_before_reconnect", settings.errors_before_reconnect);
     settings.delay_after_error_ms = json.value("delay_after_error_ms", settings.delay_after_error_ms);
@@ -88,7 +132,11 @@ Settings LoadSettings(const std::string& settings_file_name) {
         settings.frame_color = {color_json.at("R"), color_json.at("G"), color_json.at("B")};
     }
     settings.frame_width_px = json.value("frame_width_px", settings.frame_width_px);
-    settings.use_ffmpeg_writer = json.value("use_ffmpeg_writer", settings.use_ffmpeg_writer);
+    if (json.contains("video_writer")) {
+        settings.video_writer = StringToVideoWriterType(json["video_writer"].get<std::string>());
+    } else if (json.value("use_ffmpeg_writer", false)) {  // Legacy option
+        settings.video_writer = VideoWriterType::kFfmpeg;
+    }
     if (json.contains("ffmpeg_path")) {
         settings.ffmpeg_path = json.value("ffmpeg_path", settings.ffmpeg_path);
     }
@@ -97,17 +145,116 @@ Settings LoadSettings(const std::string& settings_file_name) {
     settings.video_height = json.value("video_height", settings.video_height );
     settings.video_codec = json.value("video_codec", settings.video_codec);
     settings.video_container = json.value("video_container", settings.video_container);
+    if (json.contains("libav_writer_settings")) {
+        const auto libav_writer_settings = json["libav_writer_settings"];
+        settings.libav_writer_settings = {
+            libav_writer_settings.at("codec"),
+            libav_writer_settings.at("preset"),
+            libav_writer_settings.at("tune"),
+            libav_writer_settings.at("crf"),
+            libav_writer_settings.at("threads"),
+            libav_writer_settings.at("gop_size"),
+            libav_writer_settings.at("pix_fmt")
+        };
+    }
+    settings.max_video_part_size_bytes = json.value("max_video_part_size_bytes", settings.max_video_part_size_bytes);
+    settings.max_video_part_duration = std::chrono::milliseconds(json.value("max_video_part_duration_ms", settings.max_video_part_duration.count()));
+    settings.early_video_part_duration = std::chrono::milliseconds(json.value("early_video_part_duration_ms", settings.early_video_part_duration.count()));
+    settings.use_fragmented_mp4 = json.value("use_fragmented_mp4", settings.use_fragmented_mp4);
+    settings.fragment_duration = std::chrono::milliseconds(json.value("fragment_duration_ms", settings.fragment_duration.count()));
     settings.decrease_detect_rate_while_writing = json.value("decrease_detect_rate_while_writing", settings.decrease_detect_rate_while_writing);
+    if (json.contains("pre_event_settings")) {
+        const auto pre_event_settings = json["pre_event_settings"];
+        settings.pre_event_settings = {
+            std::chrono::milliseconds(pre_event_settings.at("duration_ms")),
+            pre_event_settings.at("max_size_bytes"),
+            pre_event_settings.at("jpeg_quality"),
+            std::chrono::milliseconds(pre_event_settings.at("frames_interval_ms"))
+        };
+    }
+    if (json.contains("photo_settings")) {
+        const auto photo_settings = json["photo_settings"];
+        settings.photo_settings = {
+            photo_settings.at("jpeg_quality"),
+            photo_settings.at("save_to_disk"),
+            photo_settings.at("max_queue_size")
+        };
+    }
+    if (json.contains("async_video_writer_settings")) {
+        const auto async_video_writer_settings = json["async_video_writer_settings"];
+        settings.async_video_writer_settings = {
+            async_video_writer_settings.at("enabled"),
+            async_video_writer_settings.at("max_queue_size"),
+            StringToBufferStrategy(async_video_writer_settings.at("overflow_strategy").get<std::string>())
+        };
+    }
+    if (json.contains("continuous_recording_settings")) {
+        const auto continuous_recording_settings = json["continuous_recording_settings"];
+        settings.continuous_recording_settings = {
+            continuous_recording_settings.at("enabled"),
+            std::chrono::milliseconds(continuous_recording_settings.at("segment_duration_ms")),
+            continuous_recording_settings.at("max_queue_size")
+        };
+    }
+    if (json.contains("storage_retention_settings")) {
+        const auto storage_retention_settings = json["storage_retention_settings"];
+        std::map<StoredFileType, size_t> max_type_size_bytes;
+        for (const auto& [type, size] : storage_retention_settings.at("max_type_size_bytes").items())
+            max_type_size_bytes[StringToStoredFileType(type)] = size.get<size_t>();
+        settings.storage_retention_settings = {
+            storage_retention_settings.at("enabled"),
+            storage_retention_settings.at("max_total_size_bytes"),
+            std::chrono::hours(storage_retention_settings.at("max_age_hours")),
+            std::move(max_type_size_bytes),
+            std::chrono::milliseconds(storage_retention_settings.at("check_interval_ms")),
+            storage_retention_settings.at("max_deletes_per_check"),
+            std::chrono::hours(storage_retention_settings.at("rescan_interval_hours"))
+        };
+    }
+    if (json.contains("qos_settings")) {
+        const auto qos_settings = json["qos_settings"];
+        settings.qos_settings = {
+            qos_settings.at("enabled"),
+            qos_settings.at("max_nth_detect_frame"),
+            qos_settings.at("min_scale"),
+            qos_settings.at("target_buffer_size"),
+            qos_settings.at("cpu_budget"),
+            std::chrono::milliseconds(qos_settings.at("max_detect_latency_ms")),
+            std::chrono::milliseconds(qos_settings.at("adjust_interval_ms"))
+        };
+    }
+    if (json.contains("static_scene_settings")) {
+        const auto static_scene_settings = json["static_scene_settings"];
+        settings.static_scene_settings = {
+            static_scene_settings.at("enabled"),
+            static_scene_settings.at("max_hash_distance"),
+            std::chrono::milliseconds(static_scene_settings.at("max_skip_time_ms"))
+        };
+    }
 
     settings.bot_token = json.at("bot_token");
+    settings.telegram_api_url = json.value("telegram_api_url", settings.telegram_api_url);
     settings.allowed_users = json.at("allowed_users").get<std::set<uint64_t>>();
     if (json.contains("admin_users")) {
         settings.admin_users = json["admin_users"].get<std::set<uint64_t>>();
     }
     settings.alarm_notification_delay_ms = json.value("alarm_notification_delay_ms", settings.alarm_notification_delay_ms);
+    settings.send_workers = std::max<size_t>(json.value("send_workers", settings.send_workers), 1);
+    settings.command_workers = std::max<size_t>(json.value("command_workers", settings.command_workers), 1);
+    settings.media_group_window = std::chrono::milliseconds(json.value("media_group_window_ms", settings.media_group_window.count()));
+    if (json.contains("telegram_rate_limit_settings")) {
+        const auto telegram_rate_limit_settings = json["telegram_rate_limit_settings"];
+        settings.telegram_rate_limit_settings = {
+            telegram_rate_limit_settings.at("enabled"),
+            telegram_rate_limit_settings.at("messages_per_second"),
+            telegram_rate_limit_settings.at("chat_messages_per_second"),
+            telegram_rate_limit_settings.at("group_messages_per_minute")
+        };
+    }
     settings.preview_sampling_interval_ms = std::chrono::milliseconds(json.value("preview_sampling_interval_ms", settings.preview_sampling_interval_ms.count()));
     settings.send_video_previews = json.value("send_video_previews", settings.send_video_previews);
     settings.send_video = json.value("send_video", settings.send_video);
+    settings.send_video_progressively = json.value("send_video_progressively", settings.send_video_progressively);
 
     settings.log_level = StringToLogLevel(json.value("log_level", "Info"));
     settings.log_filename = json.value("log_filename", settings.log_filename);
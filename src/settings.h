@@ -3,7 +3,9 @@
 #include "log.h"
 
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <map>
 #include <set>
 #include <string>
 
@@ -12,6 +14,21 @@ enum class BufferOverflowStrategy {
     kDropHalf  // Drop half of buffer
 };
 
+enum class VideoWriterType {
+    kOpenCv,  // Encode decoded frames with OpenCV
+    kFfmpeg,  // Run ffmpeg process with its own connection to the source
+    kPassthrough,  // Remux compressed packets of the source, requires libav reader
+    kLibav  // Encode decoded frames with libavcodec
+};
+
+enum class StoredFileType {
+    kVideo,  // Event videos with their parts
+    kContinuous,  // Continuous recording segments
+    kPreview,  // Video previews
+    kAlarmPhoto,
+    kOnDemandPhoto
+};
+
 enum class DetectionEngine {
     kCodeprojectAi,
     kOpenCv,
@@ -36,9 +53,80 @@ struct Settings {
         std::chrono::milliseconds min_ai_call_interval{std::chrono::milliseconds(1000)};
         int min_ai_nth_frame_check{10};
     };
+    struct QosSettings {
+        bool enabled{false};  // Adapt detect rate and scale to the load
+        int max_nth_detect_frame{50};  // Upper bound of detect interval, lower bound is nth_detect_frame
+        double min_scale{0.5};  // Lower bound of scale multiplier, applied on top of img_scale_x/img_scale_y
+        size_t target_buffer_size{50};  // Frames buffer size considered as overload
+        double cpu_budget{0.8};  // Max share of processing time spent in detect
+        std::chrono::milliseconds max_detect_latency{std::chrono::milliseconds(0)};  // Max average detect time, 0 - not used
+        std::chrono::milliseconds adjust_interval{std::chrono::milliseconds(5'000)};  // Adjustment period
+    };
+    struct LibavReaderSettings {
+        std::string rtsp_transport{"tcp"};  // RTSP transport: "tcp" or "udp"
+        int64_t probe_size{500'000};  // Bytes to probe stream format, 0 - libav default
+        std::chrono::milliseconds analyze_duration{std::chrono::milliseconds(1'000)};  // 0 - libav default
+        int decoder_threads{0};  // 0 - auto
+        std::chrono::milliseconds timeout{std::chrono::milliseconds(5'000)};  // Open/read timeout
+        bool low_delay{true};  // Disable input buffering and frame threading to reduce latency
+        int reorder_queue_size{-1};  // RTSP packets reorder buffer, -1 - libav default
+    };
+    struct StaticSceneSettings {
+        bool enabled{false};  // Skip AI calls while the scene is not changed since last negative detect
+        size_t max_hash_distance{6};  // Max number of differing bits (of 256) of scene hash to consider scene unchanged
+        std::chrono::milliseconds max_skip_time{std::chrono::milliseconds(60'000)};  // Force AI call after this time
+    };
+    struct PreEventSettings {
+        std::chrono::milliseconds duration{std::chrono::milliseconds(0)};  // Time to record before detection, 0 - disabled
+        size_t max_size_bytes{64'000'000};  // Memory limit of pre-event buffer
+        int jpeg_quality{70};  // Quality of frames kept for encoding writers. Not used with passthrough writer
+        std::chrono::milliseconds frames_interval{std::chrono::milliseconds(200)};  // Min interval of kept frames
+    };
+    struct PhotoSettings {
+        int jpeg_quality{95};  // Quality of alarm and on-demand photos
+        bool save_to_disk{true};  // Photos are sent from memory and written in background. Photos failed to send are written anyway
+        size_t max_queue_size{8};  // Photos waiting for encoding, the newest ones are dropped on overflow
+    };
+    struct AsyncVideoWriterSettings {
+        bool enabled{false};  // Write video in separate thread, finalize files in background
+        size_t max_queue_size{250};  // Frames or packets queued for writing
+        BufferOverflowStrategy overflow_strategy{BufferOverflowStrategy::kDelay};  // kDropHalf drops frames only, never packets
+    };
+    struct ContinuousRecordingSettings {
+        bool enabled{false};  // Record the source stream 24/7, in addition to event videos. Requires libav reader
+        std::chrono::milliseconds segment_duration{std::chrono::minutes(10)};  // Segment is started at the next keyframe
+        size_t max_queue_size{1'000};  // Packets queued for writing. On overflow packets are dropped till the next keyframe
+    };
+    struct StorageRetentionSettings {
+        bool enabled{false};  // Delete the oldest files to keep storage within limits
+        size_t max_total_size_bytes{0};  // Limit of all stored files, 0 - not limited
+        std::chrono::hours max_age{std::chrono::hours(0)};  // 0 - not limited
+        std::map<StoredFileType, size_t> max_type_size_bytes;  // Limits of specific file types
+        std::chrono::milliseconds check_interval{std::chrono::milliseconds(60'000)};
+        size_t max_deletes_per_check{200};  // Limits I/O burst, storage is reported full if it's not enough
+        std::chrono::hours rescan_interval{std::chrono::hours(24)};  // Full rescan fixes tally of files changed by others
+    };
+    struct TelegramRateLimitSettings {
+        bool enabled{true};  // Spread sends over time to stay within Bot API limits
+        double messages_per_second{30.0};  // Global limit
+        double chat_messages_per_second{1.0};  // Limit for a single private chat
+        double group_messages_per_minute{20.0};  // Limit for a single group
+    };
+    struct LibavWriterSettings {
+        std::string codec{"libx264"};  // Encoder name
+        std::string preset{"veryfast"};  // Encoder speed/size tradeoff, empty - encoder default
+        std::string tune{};  // Encoder tune, e. g. "zerolatency", empty - not used
+        int crf{26};  // Constant rate factor, -1 - encoder default
+        int threads{0};  // 0 - auto
+        int gop_size{50};  // Keyframe interval, in frames
+        std::string pix_fmt{"yuv420p"};  // Encoder input pixel format
+    };
 
     // General settings
     std::string source;  // Video source
+    std::string detect_source;  // Optional low-res video source (camera sub-stream) for detect, empty - use source
+    bool use_libav_reader{false};  // Read source with libav instead of OpenCV
+    LibavReaderSettings libav_reader_settings{};
     std::filesystem::path storage_path{"c:\\tmp"};  // Storage for video and images
     size_t errors_before_reconnect{5};  // Frame obtain errors before reconnect attempt
     size_t delay_after_error_ms{2'000};  // Delay after frame obtain error
@@ -60,23 +148,42 @@ struct Settings {
     std::string img_format{"jpg"};  // Any cv and mime compatible type
     Color frame_color{200.0, 0.0, 0.0};  // Color of the frame around object
     int frame_width_px{1};  // Width of frame line
-    bool use_ffmpeg_writer{false};  // Use ffmpeg writer
+    PhotoSettings photo_settings{};
+    VideoWriterType video_writer{VideoWriterType::kOpenCv};  // Video writer type
     std::string ffmpeg_path{};  // Path to ffmpeg, without trailing slash
     bool use_video_scale{true};  // Scale saved videos
     int video_width{1024};  // Scaled video width
     int video_height{576};  // Scaled video height
     std::string video_codec{"avc1"};  // Codec for video output
     std::string video_container{"mp4"};  // Container for video output
+    LibavWriterSettings libav_writer_settings{};
+    size_t max_video_part_size_bytes{40'000'000};  // Video is split into parts at write time, 0 - not limited
+    std::chrono::milliseconds max_video_part_duration{std::chrono::milliseconds(0)};  // 0 - not limited
+    std::chrono::milliseconds early_video_part_duration{std::chrono::milliseconds(0)};  // Duration limit of the first part, 0 - same as max_video_part_duration
+    bool use_fragmented_mp4{false};  // Write fragmented mp4, so the file is playable while being written. Libav and passthrough writers only
+    std::chrono::milliseconds fragment_duration{std::chrono::milliseconds(1'000)};  // Fragment duration of fragmented mp4
     bool decrease_detect_rate_while_writing{false};  // Override nth_detect_frame - pass to Engine 1 frame per second approx.
+    PreEventSettings pre_event_settings{};
+    AsyncVideoWriterSettings async_video_writer_settings{};
+    ContinuousRecordingSettings continuous_recording_settings{};
+    StorageRetentionSettings storage_retention_settings{};
+    QosSettings qos_settings{};
+    StaticSceneSettings static_scene_settings{};
 
     // Telegram bot preferences
     std::string bot_token;  // Keep this in secret
+    std::string telegram_api_url{"https://api.telegram.org"};  // Bot API server, e. g. self-hosted one
     std::set<uint64_t> allowed_users;  // allowed users
     std::set<uint64_t> admin_users;  // admin users
     size_t alarm_notification_delay_ms{20'000};  // Delay before next telegram alarm
-    std::chrono::milliseconds preview_sampling_interval_ms{std::chrono::milliseconds(2'000)};  // Images for preview are saved at this interval. Required number of preview images will be selected from the saved images
+    size_t send_workers{4};  // Max number of recipients a message is sent to concurrently, 1 - sequential sending
+    size_t command_workers{2};  // Max number of users whose commands are executed concurrently
+    TelegramRateLimitSettings telegram_rate_limit_settings{};
+    std::chrono::milliseconds media_group_window{std::chrono::milliseconds(500)};  // Previews and alarm photos queued within this time are sent as album, 0 - only already queued ones
+    std::chrono::milliseconds preview_sampling_interval_ms{std::chrono::milliseconds(2'000)};  // Initial interval of preview images sampling. Interval grows for long videos, to keep the number of kept images bounded
     bool send_video_previews{true};  // Send video preview as soon as video has been recorded
     bool send_video{false};  // Send video right after recording
+    bool send_video_progressively{false};  // Send video parts as soon as they are written, instead of the whole video after recording
 
     // Log options
     int log_level{LogLevel::kInfo};  // Log level
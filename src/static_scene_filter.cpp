@@ -0,0 +1,79 @@
+#include "static_scene_filter.h"
+
+#include "log.h"
+#include "metrics.h"
+
+constexpr uint64_t kMetricsExportInterval = 100;
+
+StaticSceneFilter::StaticSceneFilter(const Settings::StaticSceneSettings& settings)
+    : enabled_(settings.enabled)
+    , max_distance_(settings.max_hash_distance)
+    , max_skip_time_(settings.max_skip_time) {
+}
+
+StaticSceneFilter::Hash StaticSceneFilter::CalcHash(const cv::Mat& image) {
+    static thread_local cv::Mat small;
+    static thread_local cv::Mat gray;
+    cv::resize(image, small, cv::Size(kHashSide, kHashSide), 0, 0, cv::INTER_AREA);
+    if (small.channels() == 3) {
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        gray = small;
+    }
+
+    const auto mean = cv::mean(gray)[0];
+    Hash hash;
+    for (int y = 0; y < kHashSide; ++y) {
+        const auto* row = gray.ptr<uchar>(y);
+        for (int x = 0; x < kHashSide; ++x) {
+            hash[static_cast<size_t>(y * kHashSide + x)] = row[x] > mean;
+        }
+    }
+    return hash;
+}
+
+bool StaticSceneFilter::CanSkip(const cv::Mat& image) {
+    if (!enabled_)
+        return false;
+
+    ++checks_;
+    cur_hash_ = CalcHash(image);
+
+    bool skip = false;
+    if (reference_hash_ && std::chrono::steady_clock::now() - last_detect_time_ < max_skip_time_) {
+        const auto distance = (cur_hash_ ^ *reference_hash_).count();
+        LOG_TRACE << "Static scene hash distance = " << distance;
+        skip = distance <= max_distance_;
+    }
+
+    if (skip)
+        ++skipped_;
+    if (checks_ % kMetricsExportInterval == 0)
+        ExportMetrics();
+    return skip;
+}
+
+void StaticSceneFilter::OnDetect(bool nothing_detected, std::chrono::steady_clock::duration latency) {
+    if (!enabled_)
+        return;
+
+    last_detect_time_ = std::chrono::steady_clock::now();
+    detect_time_total_ += latency;
+    ++detects_;
+
+    if (nothing_detected) {
+        reference_hash_ = cur_hash_;
+    } else {
+        reference_hash_.reset();
+    }
+}
+
+void StaticSceneFilter::ExportMetrics() const {
+    const auto avg_detect_ms = detects_ == 0
+        ? 0.0
+        : std::chrono::duration<double, std::milli>(detect_time_total_).count() / static_cast<double>(detects_);
+    AppMetrics->Set("static_scene_checks", static_cast<double>(checks_));
+    AppMetrics->Set("static_scene_skipped", static_cast<double>(skipped_));
+    AppMetrics->Set("static_scene_skip_ratio", static_cast<double>(skipped_) / static_cast<double>(checks_));
+    AppMetrics->Set("static_scene_time_saved_s", avg_detect_ms * static_cast<double>(skipped_) / 1000.0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "settings.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <bitset>
+#include <chrono>
+#include <optional>
+
+// Allows to skip AI calls while the scene stays the same as on the last frame with nothing detected.
+// Scene is compared by block-mean perceptual hash of downsampled frame
+class StaticSceneFilter final {
+public:
+    static constexpr int kHashSide = 16;
+    using Hash = std::bitset<kHashSide * kHashSide>;
+
+    explicit StaticSceneFilter(const Settings::StaticSceneSettings& settings);
+
+    // Calculates hash of the image and checks if detect could be skipped
+    bool CanSkip(const cv::Mat& image);
+    // Should be called after each real detect call, for the image passed to the last CanSkip()
+    void OnDetect(bool nothing_detected, std::chrono::steady_clock::duration latency);
+
+    static Hash CalcHash(const cv::Mat& image);
+
+private:
+    void ExportMetrics() const;
+
+    const bool enabled_{false};
+    const size_t max_distance_{0};
+    const std::chrono::milliseconds max_skip_time_{0};
+
+    Hash cur_hash_;
+    std::optional<Hash> reference_hash_;  // Hash of the last frame with nothing detected
+    std::chrono::steady_clock::time_point last_detect_time_{};
+
+    uint64_t checks_{0};
+    uint64_t skipped_{0};
+    std::chrono::steady_clock::duration detect_time_total_{};
+    uint64_t detects_{0};
+};
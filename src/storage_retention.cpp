@@ -0,0 +1,291 @@
+#include "storage_retention.h"
+
+#include "continuous_recorder.h"
+#include "log.h"
+#include "metrics.h"
+#include "translation.h"
+#include "uid_utils.h"
+#include "video_writer.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+
+const std::vector<std::pair<std::string, StoredFileType>>& GetFilePrefixToType() {
+    // Prefixes are defined in other translation units, so they're not used for static initialization
+    static const std::vector<std::pair<std::string, StoredFileType>> prefix_to_type = {
+        {VideoWriter::kVideoFilePrefix, StoredFileType::kVideo},
+        {ContinuousRecorder::kFilePrefix, StoredFileType::kContinuous},
+        {"preview_", StoredFileType::kPreview},
+        {"alarm_", StoredFileType::kAlarmPhoto},
+        {"on_demand_", StoredFileType::kOnDemandPhoto}
+    };
+    return prefix_to_type;
+}
+
+void SetLowIoPriority() {
+#ifdef __linux__
+    // Idle I/O class: disk is accessed only when nobody else needs it. Applied to the calling thread only
+    constexpr int kIoprioWhoProcess = 1;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+    if (syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift) != 0)
+        LOG_WARNING << "Unable to set low I/O priority for storage retention thread";
+#endif
+}
+
+}  // namespace
+
+StorageRetention::StorageRetention(const Settings& settings, telegram::BotFacade* bot)
+    : storage_path_(settings.storage_path)
+    , settings_(settings.storage_retention_settings)
+    , storage_error_(bot, translation::errors::kStorageFull, translation::errors::kStorageRestored) {
+}
+
+StorageRetention::~StorageRetention() {
+    Stop();
+}
+
+void StorageRetention::Start() {
+    if (thread_.joinable()) {
+        LOG_INFO << "Attempt start() on already running storage retention";
+        return;
+    }
+    thread_ = std::jthread(std::bind_front(&StorageRetention::ThreadFunc, this));
+}
+
+void StorageRetention::Stop() {
+    thread_.request_stop();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void StorageRetention::SetFileDeletedCallback(FileDeletedCallback callback) {
+    file_deleted_callback_ = std::move(callback);
+}
+
+std::optional<StoredFileType> StorageRetention::GetFileType(const std::filesystem::path& file_path) {
+    const auto file_name = file_path.filename().generic_string();
+    for (const auto& [prefix, type] : GetFilePrefixToType()) {
+        if (file_name.starts_with(prefix))
+            return type;
+    }
+    return std::nullopt;
+}
+
+void StorageRetention::AddFile(const std::filesystem::path& file_path) {
+    std::lock_guard lock(mutex_);
+    pending_files_.push_back(file_path);
+}
+
+void StorageRetention::AddVideo(const std::string& uid, const std::string& prefix) {
+    // Part files are checked one by one, which is much cheaper than directory scan
+    std::vector<std::filesystem::path> files;
+    for (size_t part_number = 1; ; ++part_number) {
+        auto file_path = storage_path_ / VideoWriter::GeneratePartFileName(uid, part_number, prefix);
+        if (!std::filesystem::exists(file_path))
+            break;
+        files.push_back(std::move(file_path));
+    }
+
+    std::lock_guard lock(mutex_);
+    pending_files_.insert(end(pending_files_), std::make_move_iterator(begin(files)), std::make_move_iterator(end(files)));
+}
+
+void StorageRetention::Register(const std::filesystem::path& file_path) {
+    const auto type = GetFileType(file_path);
+    if (!type)
+        return;
+
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(file_path, ec);
+    const auto write_time = ec ? std::filesystem::file_time_type{} : std::filesystem::last_write_time(file_path, ec);
+    if (ec) {
+        LOG_WARNING << "Unable to get file info: " << file_path << ", " << ec.message();
+        return;
+    }
+
+    auto& type_files = files_[*type];
+    // File might be registered already, e. g. if it was being written at rescan
+    const auto path_str = file_path.generic_string();
+    if (const auto it = write_times_.find(path_str); it != write_times_.end()) {
+        const auto old = type_files.files.find(FileInfo{it->second, file_path});
+        if (old != type_files.files.end()) {
+            type_files.size_bytes -= old->size_bytes;
+            total_size_bytes_ -= old->size_bytes;
+            type_files.files.erase(old);
+        }
+    }
+
+    type_files.files.insert(FileInfo{write_time, file_path, static_cast<size_t>(size)});
+    type_files.size_bytes += size;
+    total_size_bytes_ += size;
+    write_times_[path_str] = write_time;
+}
+
+void StorageRetention::Rescan() {
+    LOG_INFO << "Storage retention rescan";
+    files_.clear();
+    write_times_.clear();
+    failed_files_.clear();
+    total_size_bytes_ = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(storage_path_, ec)) {
+        if (entry.is_regular_file())
+            Register(entry.path());
+    }
+    if (ec)
+        LOG_ERROR_EX << "Unable to scan storage: " << ec.message();
+    last_rescan_ = std::chrono::steady_clock::now();
+    LOG_INFO << "Storage retention rescan finished, " << LOG_VAR(total_size_bytes_);
+}
+
+std::optional<StoredFileType> StorageRetention::GetOldestType() const {
+    std::optional<StoredFileType> result;
+    const FileInfo* oldest = nullptr;
+    for (const auto& [type, type_files] : files_) {
+        if (!type_files.files.empty() && (!oldest || *type_files.files.begin() < *oldest)) {
+            oldest = &*type_files.files.begin();
+            result = type;
+        }
+    }
+    return result;
+}
+
+std::vector<std::filesystem::path> StorageRetention::GetVideoFiles(StoredFileType type, const std::filesystem::path& file_path) const {
+    // Parts are deleted together with the main file, so the video is never left half-deleted
+    const auto& prefix = type == StoredFileType::kContinuous ? ContinuousRecorder::kFilePrefix : VideoWriter::kVideoFilePrefix;
+    const auto uid = GetUidFromFileName(file_path.filename().generic_string());
+    std::vector<std::filesystem::path> files;
+    for (size_t part_number = 1; ; ++part_number) {
+        auto part_path = storage_path_ / VideoWriter::GeneratePartFileName(uid, part_number, prefix);
+        const bool present = write_times_.contains(part_path.generic_string()) || std::filesystem::exists(part_path);
+        if (!present && part_number > 1)  // The main file might be deleted by others
+            break;
+        if (present)
+            files.push_back(std::move(part_path));
+    }
+    if (std::find(begin(files), end(files), file_path) == end(files))
+        files.push_back(file_path);
+    return files;
+}
+
+bool StorageRetention::DeleteFile(StoredFileType type, const std::filesystem::path& file_path) {
+    auto& type_files = files_[type];
+    const auto time_it = write_times_.find(file_path.generic_string());
+    const auto it = time_it == write_times_.end() ? type_files.files.end() : type_files.files.find(FileInfo{time_it->second, file_path});
+
+    std::error_code ec;
+    std::filesystem::remove(file_path, ec);
+    if (ec) {
+        // File might be in use (e. g. being sent) or not permitted to delete, the next files are deleted meanwhile
+        LOG_WARNING << "Unable to delete file: " << file_path << ", " << ec.message();
+        if (it != type_files.files.end()) {
+            failed_files_.emplace_back(type, *it);
+            type_files.files.erase(it);
+        }
+        return false;
+    }
+
+    LOG_DEBUG << "Storage retention deleted file: " << file_path;
+    if (file_deleted_callback_)
+        file_deleted_callback_(file_path, type);
+    if (deletes_left_ > 0)
+        --deletes_left_;
+    if (it != type_files.files.end()) {
+        type_files.size_bytes -= it->size_bytes;
+        total_size_bytes_ -= it->size_bytes;
+        type_files.files.erase(it);
+    }
+    if (time_it != write_times_.end())
+        write_times_.erase(time_it);
+    AppMetrics->Add("storage_retention_deleted_files");
+    return true;
+}
+
+bool StorageRetention::DeleteOldest(StoredFileType type) {
+    const auto& type_files = files_[type];
+    if (type_files.files.empty() || deletes_left_ == 0)
+        return false;
+
+    // If the oldest file is not deleted, it's skipped till the next check, so the caller goes on with the next one
+    const auto file_path = type_files.files.begin()->path;
+    if (type == StoredFileType::kVideo || type == StoredFileType::kContinuous) {
+        for (const auto& video_file_path : GetVideoFiles(type, file_path))
+            DeleteFile(type, video_file_path);
+    } else {
+        DeleteFile(type, file_path);
+    }
+    return true;
+}
+
+void StorageRetention::RestoreFailedFiles() {
+    for (auto& [type, file_info] : failed_files_)
+        files_[type].files.insert(std::move(file_info));
+    failed_files_.clear();
+}
+
+bool StorageRetention::Cleanup() {
+    deletes_left_ = settings_.max_deletes_per_check;
+
+    if (settings_.max_age.count() > 0) {
+        const auto min_write_time = std::filesystem::file_time_type::clock::now() - settings_.max_age;
+        for (auto& [type, type_files] : files_) {
+            while (!type_files.files.empty() && type_files.files.begin()->write_time < min_write_time) {
+                if (!DeleteOldest(type))
+                    return false;
+            }
+        }
+    }
+
+    for (const auto& [type, max_size_bytes] : settings_.max_type_size_bytes) {
+        while (max_size_bytes > 0 && files_[type].size_bytes > max_size_bytes) {
+            if (!DeleteOldest(type))
+                return false;
+        }
+    }
+
+    while (settings_.max_total_size_bytes > 0 && total_size_bytes_ > settings_.max_total_size_bytes) {
+        const auto type = GetOldestType();
+        if (!type || !DeleteOldest(*type))
+            return false;
+    }
+
+    return true;
+}
+
+void StorageRetention::ThreadFunc(std::stop_token stop_token) {
+    SetLowIoPriority();
+    Rescan();
+    while (!stop_token.stop_requested()) {
+        std::vector<std::filesystem::path> pending_files;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait_for(lock, stop_token, settings_.check_interval, [] { return false; });
+            if (stop_token.stop_requested())
+                break;
+            std::swap(pending_files, pending_files_);
+        }
+
+        if (std::chrono::steady_clock::now() - last_rescan_ >= settings_.rescan_interval) {
+            Rescan();
+        } else {
+            for (const auto& file_path : pending_files)
+                Register(file_path);
+        }
+
+        const bool result = Cleanup();
+        RestoreFailedFiles();
+        if (!result)
+            LOG_WARNING_EX << "Storage retention can't keep up, " << LOG_VAR(total_size_bytes_);
+        storage_error_.Update(result ? ErrorReporter::ErrorState::kNoError : ErrorReporter::ErrorState::kError);
+        AppMetrics->Set("storage_used_bytes", static_cast<double>(total_size_bytes_));
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "error_reporter.h"
+#include "settings.h"
+#include "telegram_bot_facade.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Keeps storage within configured limits, deleting the oldest files first. Size tally is kept in memory: written
+// files are registered by their owners, and the storage is scanned on start only (and rarely, to fix the drift caused
+// by files changed by others). Files are deleted in own thread with low I/O priority
+class StorageRetention final {
+public:
+    StorageRetention(const Settings& settings, telegram::BotFacade* bot);
+    ~StorageRetention();
+
+    StorageRetention(const StorageRetention&) = delete;
+    StorageRetention(StorageRetention&&) = delete;
+    StorageRetention& operator=(const StorageRetention&) = delete;
+    StorageRetention& operator=(StorageRetention&&) = delete;
+
+    void Start();
+    void Stop();
+
+    using FileDeletedCallback = std::function<void(const std::filesystem::path& file_path, StoredFileType type)>;
+    void SetFileDeletedCallback(FileDeletedCallback callback);  // Should be called before Start(), called from retention thread
+
+    // Thread safe. Files are accounted at the next check
+    void AddFile(const std::filesystem::path& file_path);
+    void AddVideo(const std::string& uid, const std::string& prefix);  // Video file with all its parts
+
+    static std::optional<StoredFileType> GetFileType(const std::filesystem::path& file_path);
+
+private:
+    struct FileInfo {
+        std::filesystem::file_time_type write_time;
+        std::filesystem::path path;
+        size_t size_bytes{0};
+
+        bool operator<(const FileInfo& other) const {
+            return std::tie(write_time, path) < std::tie(other.write_time, other.path);
+        }
+    };
+    struct TypeFiles {
+        std::set<FileInfo> files;  // The oldest first
+        size_t size_bytes{0};
+    };
+
+    void ThreadFunc(std::stop_token stop_token);
+    void Rescan();
+    void Register(const std::filesystem::path& file_path);
+    bool Cleanup();  // Returns false if limits are still exceeded
+    bool DeleteOldest(StoredFileType type);  // Returns false if there's nothing more to delete at this check
+    bool DeleteFile(StoredFileType type, const std::filesystem::path& file_path);
+    std::vector<std::filesystem::path> GetVideoFiles(StoredFileType type, const std::filesystem::path& file_path) const;
+    void RestoreFailedFiles();
+    std::optional<StoredFileType> GetOldestType() const;
+
+    const std::filesystem::path storage_path_;
+    const Settings::StorageRetentionSettings settings_;
+    FileDeletedCallback file_deleted_callback_;
+
+    // Accessed from retention thread only
+    std::map<StoredFileType, TypeFiles> files_;
+    std::unordered_map<std::string, std::filesystem::file_time_type> write_times_;  // Registered files, by path
+    size_t total_size_bytes_{0};
+    size_t deletes_left_{0};
+    // Files which failed to delete at the current check, e. g. being sent or not permitted. Their size is still
+    // accounted, and they are retried at the next check
+    std::vector<std::pair<StoredFileType, FileInfo>> failed_files_;
+    std::chrono::time_point<std::chrono::steady_clock> last_rescan_{};
+    ErrorReporter storage_error_;
+
+    std::vector<std::filesystem::path> pending_files_;
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::jthread thread_;
+};
@@ -2,17 +2,22 @@
 
 #include "helpers.h"
 #include "log.h"
+#include "metrics.h"
 #include "ring_buffer.h"
 #include "safe_ptr.h"
 #include "translation.h"
 #include "uid_utils.h"
+#include "video_utils.h"
 #include "video_writer.h"
 
 #include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <ctime>
+#include <iomanip>
 #include <regex>
 #include <set>
+#include <sstream>
 
 constexpr size_t kMaxMessageLen{4096};
 constexpr std::chrono::minutes kDefaultPauseTime{60};
@@ -60,11 +65,6 @@ std::optional<Filter> GetFilter(const std::string& text) {
     return std::optional<Filter>{GetParameterTimeMin(text)};
 }
 
-bool ApplyFilter(const Filter& filter, const std::string& file_name) {
-    const auto uid = GetUidFromFileName(file_name);
-    return std::chrono::system_clock::now() - GetTimestampFromUid(uid) < filter.depth;
-}
-
 std::string GetUptime() {
     const auto diff_s = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - kStartTime).count();
     auto formatted = std::format("{:01}d {:02}:{:02}:{:02}"
@@ -75,45 +75,51 @@ std::string GetUptime() {
     return formatted;
 }
 
-struct VideoFileInfo {
-    std::string uid;
-    size_t size_mb;
+// Archive timestamps are local time, in the same format as uid
+std::string GetArchiveTimestamp(std::chrono::system_clock::time_point timestamp) {
+    const auto zoned = std::chrono::zoned_time{std::chrono::current_zone(), std::chrono::floor<std::chrono::seconds>(timestamp)};
+    return std::format("{:%Y%m%dT%H%M%S}", zoned);
+}
 
-    bool operator<(const VideoFileInfo& other) const {
-        return uid < other.uid;
-    }
-};
-
-std::set<VideoFileInfo> CollectVideoFileUids(const std::filesystem::path& storage_path, const std::optional<telegram::Filter>& filter) {
-    std::set<VideoFileInfo> files;
-    for (const auto& entry : std::filesystem::directory_iterator(storage_path)) {
-        if (VideoWriter::IsVideoFile(entry.path())) {
-            const auto file_name = entry.path().filename().generic_string();
-            if (!filter || ApplyFilter(*filter, file_name)) {
-                files.emplace(GetUidFromFileName(file_name), GetFileSizeMb(entry));
-            }
-        }
-    }
-    return files;
+std::optional<std::chrono::system_clock::time_point> ParseArchiveTimestamp(const std::string& text) {
+    std::tm tm = {};
+    tm.tm_isdst = -1;
+    std::stringstream sstream(text);
+    sstream >> std::get_time(&tm, "%Y%m%dT%H%M%S");
+    if (sstream.fail())
+        return std::nullopt;
+    return std::chrono::system_clock::from_time_t(std::mktime(&tm));
 }
 
 std::chrono::system_clock::time_point GetDateTime(TgBot::Message::Ptr message) {
     return std::chrono::system_clock::time_point(std::chrono::seconds(message->date));
 }
 
+// Whole video is sent as its part files, big file is split here
+std::vector<telegram::messages::Video> GetVideoParts(const telegram::messages::Video& video) {
+    const auto part_files = GetSplittedFileNames(video.file_path);
+    std::vector<telegram::messages::Video> parts;
+    for (size_t i = 0; i < part_files.size(); ++i)
+        parts.push_back(telegram::messages::Video{video.recipients, part_files[i], i + 1, part_files.size()});
+    return parts;
+}
+
 }  // namespace
 
-BotFacade::BotFacade(const std::string& token, std::filesystem::path storage_path, std::set<uint64_t> allowed_users, std::set<uint64_t> admin_users)
+BotFacade::BotFacade(const std::string& token, const std::string& api_url, std::filesystem::path storage_path, std::set<uint64_t> allowed_users, std::set<uint64_t> admin_users,
+                     std::shared_ptr<const RecordingsIndex> recordings_index, size_t send_workers,
+                     const Settings::TelegramRateLimitSettings& rate_limit_settings, std::chrono::milliseconds media_group_window,
+                     size_t command_workers)
     : bot_{std::make_unique<TgBot::Bot>(
-        token
-#ifdef HAVE_CURL
-      , http_client_
-#endif
+        token, http_client_, api_url
     )}
-    , message_sender_{bot_.get(), storage_path}
+    , message_sender_{bot_.get(), api_url, storage_path, send_workers, rate_limit_settings}
     , storage_path_{std::move(storage_path)}
     , allowed_users_{std::move(allowed_users)}
-    , admin_users_{std::move(admin_users)} {
+    , admin_users_{std::move(admin_users)}
+    , recordings_index_{std::move(recordings_index)}
+    , media_group_window_{media_group_window}
+    , command_executor_{command_workers} {
 
 #ifdef HAVE_CURL
         auto& httpClient = static_cast<const TgBot::CurlHttpClient&>(bot_->getApi()._httpClient);
@@ -129,7 +135,7 @@ BotFacade::BotFacade(const std::string& token, std::filesystem::path storage_pat
 }
 
 void BotFacade::SetupBotCommands() {
-    bot_->getEvents().onCommand(telegram::commands::kStart, [this](TgBot::Message::Ptr message) {
+    bot_->getEvents().onCommand(telegram::commands::kStart, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kStart << " from user " << message->chat->id;
         const auto id = message->chat->id;
         if (IsUserAdmin(id)) {
@@ -137,65 +143,82 @@ void BotFacade::SetupBotCommands() {
         } else if (IsUserAllowed(id)) {
             PostMenu(id);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kImage, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kImage, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kImage << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             ProcessOnDemandCmd(id);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kPing, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kPing, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kPing << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             ProcessStatusCmd(id);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kVideos, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kVideos, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kVideos << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             const auto filter = GetFilter(message->text);
             ProcessVideosCmd(id, filter);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kPreviews, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kPreviews, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kPreviews << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             const auto filter = GetFilter(message->text);
             ProcessPreviewsCmd(id, filter);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kLog, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kArchive, Dispatch([this](TgBot::Message::Ptr message) {
+        LOG_INFO << "Received command " << telegram::commands::kArchive << " from user " << message->chat->id;
+        if (const auto id = message->chat->id; IsUserAllowed(id)) {
+            const auto filter = GetFilter(message->text);
+            ProcessArchiveCmd(id, filter);
+        }
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kLog, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kLog << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAdmin(id)) {
             ProcessLogCmd(id);
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kPause, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kMetrics, Dispatch([this](TgBot::Message::Ptr message) {
+        LOG_INFO << "Received command " << telegram::commands::kMetrics << " from user " << message->chat->id;
+        if (const auto id = message->chat->id; IsUserAdmin(id)) {
+            ProcessMetricsCmd(id);
+        }
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kPause, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kPause << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             auto pause_time = GetParameterTimeMin(message->text);
             ProcessPauseCmd(id, pause_time.value_or(kDefaultPauseTime));
         }
-    });
-    bot_->getEvents().onCommand(telegram::commands::kResume, [this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onCommand(telegram::commands::kResume, Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received command " << telegram::commands::kPause << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             ProcessResumeCmd(id);
         }
-    });
-    bot_->getEvents().onAnyMessage([this](TgBot::Message::Ptr message) {
+    }));
+    bot_->getEvents().onAnyMessage(Dispatch([this](TgBot::Message::Ptr message) {
         LOG_INFO << "Received message " << message->text << " from user " << message->chat->id;
         if (const auto id = message->chat->id; IsUserAllowed(id)) {
             if (StringTools::startsWith(message->text, telegram::commands::VideoCmdPrefix())) {
                 LOG_INFO << "video command received: " << message->text;
                 const std::string uid = message->text.substr(telegram::commands::VideoCmdPrefix().size());  // uid of file
                 ProcessVideoCmd(id, uid);
+            } else if (StringTools::startsWith(message->text, telegram::commands::ArchiveCmdPrefix())) {
+                LOG_INFO << "archive command received: " << message->text;
+                const std::string timestamp = message->text.substr(telegram::commands::ArchiveCmdPrefix().size());
+                ProcessArchiveSegmentCmd(id, timestamp);
             }
         } else {
             LOG_WARNING << "Unauthorized user tried to access: " << id;
         }
-    });
-    bot_->getEvents().onCallbackQuery([this](TgBot::CallbackQuery::Ptr query) {
+    }));
+    bot_->getEvents().onCallbackQuery(Dispatch([this](TgBot::CallbackQuery::Ptr query) {
         LOG_INFO << "Received callback query " << query->message->text << " from user " << query->message->chat->id
                  << " @ " << GetDateTime(query->message);
         if (const auto id = query->message->chat->id; IsUserAllowed(id)) {
@@ -229,9 +252,26 @@ void BotFacade::SetupBotCommands() {
             } else if (StringTools::startsWith(command, telegram::commands::kLog)) {
                 ProcessLogCmd(id);
                 PostAnswerCallback(query->id);
+            } else if (StringTools::startsWith(command, telegram::commands::kMetrics)) {
+                ProcessMetricsCmd(id);
+                PostAnswerCallback(query->id);
             }
         }
-    });
+    }));
+}
+
+TgBot::EventBroadcaster::MessageListener BotFacade::Dispatch(TgBot::EventBroadcaster::MessageListener handler) {
+    return [this, handler = std::move(handler)](TgBot::Message::Ptr message) {
+        if (IsUserKnown(message->chat->id))
+            command_executor_.Post(message->chat->id, [handler, message] { handler(message); });
+    };
+}
+
+TgBot::EventBroadcaster::CallbackQueryListener BotFacade::Dispatch(TgBot::EventBroadcaster::CallbackQueryListener handler) {
+    return [this, handler = std::move(handler)](TgBot::CallbackQuery::Ptr query) {
+        if (IsUserKnown(query->message->chat->id))
+            command_executor_.Post(query->message->chat->id, [handler, query] { handler(query); });
+    };
 }
 
 BotFacade::~BotFacade() {
@@ -253,6 +293,7 @@ std::string BotFacade::PrepareStatusInfo(uint64_t requested_by) {
            GetUptime() + " " + translation::messages::kUptime;
 
     UpdatePausedUsers();
+    std::lock_guard lock(paused_users_mutex_);
     if (auto it = paused_users_.find(requested_by); it != paused_users_.end()) {
         message += std::string{",\n"} + translation::messages::kNotificationsPaused + " " + GetDateTimeString(it->second);
     }
@@ -269,16 +310,22 @@ void BotFacade::ProcessStatusCmd(uint64_t user_id) {
     PostStatusMessage(PrepareStatusInfo(user_id), user_id);
 }
 
+std::vector<RecordingsIndex::Recording> BotFacade::FindRecordings(const std::optional<Filter>& filter) const {
+    const auto now = std::chrono::system_clock::now();
+    const auto from = filter ? now - filter->depth : std::chrono::system_clock::time_point{};
+    return recordings_index_->Find(from, now);
+}
+
 void BotFacade::ProcessVideosCmd(uint64_t user_id, const std::optional<Filter>& filter) {
-    const auto files = CollectVideoFileUids(storage_path_, filter);
-    if (files.empty()) {
+    const auto recordings = FindRecordings(filter);
+    if (recordings.empty()) {
         PostTextMessage(translation::messages::kNoFilesFound, user_id);
         return;
     }
 
     std::string commands_message;
-    for (const auto& file : files) {
-        std::string command = telegram::commands::VideoCmdPrefix() + file.uid + " (" + std::to_string(file.size_mb) + " MB)\n";
+    for (const auto& recording : recordings) {
+        std::string command = telegram::commands::VideoCmdPrefix() + recording.uid + " (" + std::to_string(recording.size_bytes / 1'000'000) + " MB)\n";
         if (commands_message.size() + command.size() > kMaxMessageLen) {
             PostTextMessage(commands_message, user_id);
             commands_message = command;
@@ -290,17 +337,19 @@ void BotFacade::ProcessVideosCmd(uint64_t user_id, const std::optional<Filter>&
 }
 
 void BotFacade::ProcessPreviewsCmd(uint64_t user_id, const std::optional<Filter>& filter) {
-    const auto files = CollectVideoFileUids(storage_path_, filter);
-    if (files.empty()) {
+    const auto recordings = FindRecordings(filter);
+    if (recordings.empty()) {
         PostTextMessage(translation::messages::kNoFilesFound, user_id);
         return;
     }
 
-    for (const auto& file : files) {
-        const std::filesystem::path file_path = storage_path_ / VideoWriter::GeneratePreviewFileName(file.uid);
+    for (const auto& recording : recordings) {
+        const std::filesystem::path file_path = storage_path_ / VideoWriter::GeneratePreviewFileName(recording.uid);
         PostVideoPreview(file_path, user_id);
     }
-    PostTextMessage(translation::messages::kPreviewsSendEnded, user_id);
+    // Queued along with previews, as interactive messages are sent ahead of them
+    auto recipients = UpdateGetUnpausedRecipients({user_id}, user_id);
+    Enqueue(telegram::messages::TextMessage{std::move(recipients), translation::messages::kPreviewsSendEnded}, Priority::kPreview);
 }
 
 void BotFacade::ProcessVideoCmd(uint64_t user_id, const std::string& video_uid) {
@@ -320,27 +369,67 @@ void BotFacade::ProcessVideoCmd(uint64_t user_id, const std::string& video_uid)
     }
 }
 
-void BotFacade::ProcessLogCmd(uint64_t user_id) {
-    const auto log_lines = AppLogTail->dump();
-    if (log_lines.empty())
+void BotFacade::SetArchiveIndex(std::shared_ptr<const ArchiveIndex> archive_index) {
+    archive_index_ = std::move(archive_index);
+}
+
+void BotFacade::ProcessArchiveCmd(uint64_t user_id, const std::optional<Filter>& filter) {
+    if (!archive_index_) {
+        PostTextMessage(translation::messages::kArchiveDisabled, user_id);
+        return;
+    }
+
+    // Events are listed as commands to get the segment, which covers the event
+    const auto now = std::chrono::system_clock::now();
+    const auto from = filter ? now - filter->depth : std::chrono::system_clock::time_point{};
+    const auto events = archive_index_->GetEvents(from, now);
+    if (events.empty()) {
+        PostTextMessage(translation::messages::kNoFilesFound, user_id);
         return;
+    }
 
-    std::string message;
-    for (const auto& line : log_lines) {
-        if (message.size() + line.size() > kMaxMessageLen) {
-            PostTextMessage(message, user_id);
-            message = line;
-        } else {
-            message += line;
-        }
+    std::vector<std::string> lines;
+    lines.reserve(events.size());
+    for (const auto& event : events)
+        lines.push_back(telegram::commands::ArchiveCmdPrefix() + GetArchiveTimestamp(event) + "\n");
+    PostTextLines(lines, user_id);
+}
+
+void BotFacade::ProcessArchiveSegmentCmd(uint64_t user_id, const std::string& timestamp) {
+    if (!archive_index_) {
+        PostTextMessage(translation::messages::kArchiveDisabled, user_id);
+        return;
     }
 
-    PostTextMessage(message, user_id);
+    const auto time_point = ParseArchiveTimestamp(timestamp);
+    if (!time_point) {
+        LOG_WARNING << "User " << user_id << " asked archive with invalid timestamp: " << timestamp;
+        PostTextMessage(translation::messages::kInvalidFileRequested, user_id);
+        return;
+    }
+
+    const auto file_name = archive_index_->FindSegment(*time_point);
+    if (!file_name || !std::filesystem::exists(storage_path_ / *file_name)) {
+        PostTextMessage(translation::messages::kFileNotFound, user_id);
+        return;
+    }
+
+    LOG_INFO << "Archive segment for " << timestamp << ": " << *file_name;
+    PostVideo(storage_path_ / *file_name, user_id);
+}
+
+void BotFacade::ProcessLogCmd(uint64_t user_id) {
+    PostTextLines(AppLogTail->dump(), user_id);
+}
+
+void BotFacade::ProcessMetricsCmd(uint64_t user_id) {
+    PostTextLines(AppMetrics->Dump(), user_id);
 }
 
 void BotFacade::ProcessPauseCmd(uint64_t user_id, std::chrono::minutes pause_time) {
     const auto end_time = std::chrono::zoned_time{std::chrono::current_zone(), std::chrono::system_clock::now() + pause_time};
     PostTextMessage(translation::messages::kNotificationsPaused + " " + GetDateTimeString(end_time), user_id);
+    std::lock_guard lock(paused_users_mutex_);
     paused_users_[user_id] = end_time;
 }
 
@@ -358,6 +447,15 @@ bool BotFacade::IsUserAllowed(uint64_t user_id) const {
     return true;
 }
 
+bool BotFacade::IsUserKnown(uint64_t user_id) const {
+    // Updates from unknown chats are dropped on the poll thread, so they don't queue up in command executor
+    if (!allowed_users_.contains(user_id) && !admin_users_.contains(user_id)) {
+        LOG_WARNING << "Unauthorized user tried to access: " << user_id;
+        return false;
+    }
+    return true;
+}
+
 bool BotFacade::IsUserAdmin(uint64_t user_id) const {
     const auto it = std::find(cbegin(admin_users_), cend(admin_users_), user_id);
     if (it == cend(admin_users_)) {
@@ -372,30 +470,36 @@ bool BotFacade::SomeoneIsWaitingForPhoto() const {
     return !users_waiting_for_photo_.empty();
 }
 
-void BotFacade::PostOnDemandPhoto(const std::filesystem::path& file_path) {
-    {
-        std::set<uint64_t> recipients;
-        {
-            std::lock_guard lock(photo_mutex_);
-            std::swap(recipients, users_waiting_for_photo_);
-        }
-
-        // Do not filter users here: users explicitly request this image
+std::set<uint64_t> BotFacade::TakeUsersWaitingForPhoto() {
+    std::set<uint64_t> recipients;
+    std::lock_guard lock(photo_mutex_);
+    std::swap(recipients, users_waiting_for_photo_);
+    return recipients;
+}
 
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::OnDemandPhoto{std::move(recipients), file_path});
-    }
-    queue_cv_.notify_one();
+void BotFacade::PostOnDemandPhoto(std::set<uint64_t> recipients, const std::filesystem::path& file_path, telegram::messages::ImageData image) {
+    // Do not filter users here: users explicitly request this image
+    Enqueue(telegram::messages::OnDemandPhoto{std::move(recipients), file_path, std::move(image)});
 }
 
-void BotFacade::PostAlarmPhoto(const std::filesystem::path& file_path, const std::string& classes_detected) {
+void BotFacade::PostAlarmPhoto(const std::filesystem::path& file_path, const std::string& classes_detected, telegram::messages::ImageData image) {
     std::set<uint64_t> recipients = UpdateGetUnpausedRecipients(allowed_users_);
     if (recipients.empty())
         return;
 
+    Enqueue(telegram::messages::AlarmPhoto{std::move(recipients), file_path, classes_detected, 0, {}, std::move(image)});
+}
+
+void BotFacade::Enqueue(Message message) {
+    const auto priority = GetPriority(message);
+    Enqueue(std::move(message), priority);
+}
+
+void BotFacade::Enqueue(Message message, Priority priority) {
     {
         std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::AlarmPhoto{std::move(recipients), file_path, classes_detected});
+        auto& queue = messages_queues_[static_cast<size_t>(priority)];
+        queue.push_back(QueuedMessage{std::move(message), std::chrono::steady_clock::now()});
     }
     queue_cv_.notify_one();
 }
@@ -403,11 +507,24 @@ void BotFacade::PostAlarmPhoto(const std::filesystem::path& file_path, const std
 void BotFacade::PostStatusMessage(const std::string& message, uint64_t user_id) {
     // Explicit message - do not check
     std::set<uint64_t> recipients = std::set<uint64_t>{user_id};
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::TextMessage{std::move(recipients), message});
+    Enqueue(telegram::messages::TextMessage{std::move(recipients), message});
+}
+
+void BotFacade::PostTextLines(const std::vector<std::string>& lines, uint64_t user_id) {
+    if (lines.empty())
+        return;
+
+    std::string message;
+    for (const auto& line : lines) {
+        if (message.size() + line.size() > kMaxMessageLen) {
+            PostTextMessage(message, user_id);
+            message = line;
+        } else {
+            message += line;
+        }
     }
-    queue_cv_.notify_one();
+
+    PostTextMessage(message, user_id);
 }
 
 void BotFacade::PostTextMessage(const std::string& message, const std::optional<uint64_t>& user_id) {
@@ -415,11 +532,7 @@ void BotFacade::PostTextMessage(const std::string& message, const std::optional<
     if (recipients.empty())
         return;
 
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::TextMessage{std::move(recipients), message});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::TextMessage{std::move(recipients), message});
 }
 
 void BotFacade::PostVideoPreview(const std::filesystem::path& file_path, const std::optional<uint64_t>& user_id) {
@@ -427,11 +540,7 @@ void BotFacade::PostVideoPreview(const std::filesystem::path& file_path, const s
     if (recipients.empty())
         return;
 
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::Preview{std::move(recipients), file_path});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::Preview{std::move(recipients), file_path});
 }
 
 void BotFacade::PostVideo(const std::filesystem::path& file_path, const std::optional<uint64_t>& user_id) {
@@ -439,48 +548,42 @@ void BotFacade::PostVideo(const std::filesystem::path& file_path, const std::opt
     if (recipients.empty())
         return;
 
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::Video{std::move(recipients), file_path});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::Video{std::move(recipients), file_path});
+}
+
+void BotFacade::PostVideoPart(const std::filesystem::path& file_path, size_t part_number) {
+    std::set<uint64_t> recipients = UpdateGetUnpausedRecipients(allowed_users_, std::nullopt);
+    if (recipients.empty())
+        return;
+
+    Enqueue(telegram::messages::Video{std::move(recipients), file_path, part_number});
 }
 
 void BotFacade::PostMenu(uint64_t user_id) {
     // Do not check for paused user
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::Menu{user_id});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::Menu{user_id});
 }
 
 void BotFacade::PostAdminMenu(uint64_t user_id) {
     // Do not check for paused user
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::AdminMenu{user_id});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::AdminMenu{user_id});
 }
 
 void BotFacade::PostAnswerCallback(const std::string& callback_id) {
     // Do not check for paused user
-    {
-        std::lock_guard lock(queue_mutex_);
-        messages_queue_.push_back(telegram::messages::Answer{callback_id});
-    }
-    queue_cv_.notify_one();
+    Enqueue(telegram::messages::Answer{callback_id});
 }
 
 void BotFacade::UpdatePausedUsers() {
     const auto cur_time = std::chrono::zoned_time{std::chrono::current_zone(), std::chrono::system_clock::now()}.get_local_time();
+    std::lock_guard lock(paused_users_mutex_);
     std::erase_if(paused_users_, [&cur_time](const auto& p) {
         return p.second.get_local_time() <= cur_time;
     });
 }
 
 void BotFacade::RemoveUserFromPaused(uint64_t user_id) {
+    std::lock_guard lock(paused_users_mutex_);
     std::erase_if(paused_users_, [user_id](const auto& p) {
         return p.first == user_id;
     });
@@ -491,6 +594,7 @@ std::set<uint64_t> BotFacade::UpdateGetUnpausedRecipients(const std::set<uint64_
     UpdatePausedUsers();
 
     auto res = users;
+    std::lock_guard lock(paused_users_mutex_);
     for (const auto& p : paused_users_) {
         if (auto it = res.find(p.first); it != res.end()) {
             res.erase(it);
@@ -523,18 +627,84 @@ void BotFacade::PollThreadFunc(std::stop_token stop_token) {
     }
 }
 
+bool BotFacade::SplitVideo(const telegram::messages::Video& video, std::chrono::steady_clock::time_point queued_at) {
+    if (video.part_number > 0 || !std::filesystem::exists(video.file_path))
+        return false;
+
+    // Splitting might take a while for big files, so it's done here rather than on posting
+    auto parts = GetVideoParts(video);
+    std::lock_guard lock(queue_mutex_);
+    auto& queue = messages_queues_[static_cast<size_t>(Priority::kVideo)];
+    for (auto it = rbegin(parts); it != rend(parts); ++it)  // Parts are sent before the rest of queued videos
+        queue.push_front(QueuedMessage{std::move(*it), queued_at});
+    return true;
+}
+
+Message BotFacade::GroupMedia(Message message, std::deque<QueuedMessage>& queue) {
+    if (const auto preview = std::get_if<telegram::messages::Preview>(&message)) {
+        auto group = telegram::messages::PreviewGroup{preview->recipients, {preview->file_path}};
+        while (!queue.empty() && group.file_paths.size() < telegram::messages::kMaxMediaGroupSize) {
+            const auto next = std::get_if<telegram::messages::Preview>(&queue.front().message);
+            if (!next || next->recipients != group.recipients)
+                break;
+            group.file_paths.push_back(next->file_path);
+            queue.pop_front();
+        }
+        if (group.file_paths.size() > 1)
+            return group;
+    } else if (const auto alarm = std::get_if<telegram::messages::AlarmPhoto>(&message)) {
+        auto group = telegram::messages::AlarmPhotoGroup{alarm->recipients, {*alarm}};
+        while (!queue.empty() && group.alarms.size() < telegram::messages::kMaxMediaGroupSize) {
+            const auto next = std::get_if<telegram::messages::AlarmPhoto>(&queue.front().message);
+            if (!next || next->recipients != group.recipients)
+                break;
+            group.alarms.push_back(*next);
+            queue.pop_front();
+        }
+        if (group.alarms.size() > 1)
+            return group;
+    }
+    return message;
+}
+
 void BotFacade::QueueThreadFunc(std::stop_token stop_token) {
     while (!stop_token.stop_requested()) {
         std::unique_lock lock(queue_mutex_);
-        queue_cv_.wait(lock, [&] { return !messages_queue_.empty() || stop_token.stop_requested(); });
+        const auto non_empty_queue = [&] {
+            return std::find_if(begin(messages_queues_), end(messages_queues_), [](const auto& queue) { return !queue.empty(); });
+        };
+        queue_cv_.wait(lock, [&] { return non_empty_queue() != end(messages_queues_) || stop_token.stop_requested(); });
         if (stop_token.stop_requested())
             break;
 
-        const auto message = messages_queue_.front();
-        messages_queue_.pop_front();
+        const auto queue = non_empty_queue();
+        const bool groupable = std::holds_alternative<telegram::messages::Preview>(queue->front().message)
+                               || std::holds_alternative<telegram::messages::AlarmPhoto>(queue->front().message);
+        if (groupable && media_group_window_.count() > 0) {
+            // Wait a bit for the rest of the burst, unless more urgent message arrives
+            const auto group_deadline = queue->front().queued_at + media_group_window_;
+            queue_cv_.wait_until(lock, group_deadline, [&] { return non_empty_queue() != queue || stop_token.stop_requested(); });
+            if (stop_token.stop_requested())
+                break;
+            if (non_empty_queue() != queue)
+                continue;
+        }
+
+        auto queued = std::move(queue->front());
+        queue->pop_front();
+        if (groupable)
+            queued.message = GroupMedia(std::move(queued.message), *queue);
+        const auto priority_name = GetPriorityName(static_cast<Priority>(std::distance(begin(messages_queues_), queue)));
+        AppMetrics->Set("telegram_queue_size_" + priority_name, static_cast<double>(queue->size()));
         lock.unlock();
 
-        std::visit(message_sender_, message);
+        if (const auto video = std::get_if<telegram::messages::Video>(&queued.message); video && SplitVideo(*video, queued.queued_at))
+            continue;
+
+        const auto wait_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - queued.queued_at);
+        AppMetrics->Set("telegram_queue_wait_ms_" + priority_name, static_cast<double>(wait_time.count()));
+
+        std::visit(message_sender_, queued.message);
     }
 }
 
@@ -544,6 +714,7 @@ void BotFacade::Start() {
         return;
     }
 
+    command_executor_.Start();
     poll_thread_ = std::jthread(std::bind_front(&BotFacade::PollThreadFunc, this));
     queue_thread_ = std::jthread(std::bind_front(&BotFacade::QueueThreadFunc, this));
 }
@@ -563,8 +734,32 @@ void BotFacade::Stop() {
     if (poll_thread_.joinable())
         poll_thread_.join();
 
+    command_executor_.Stop();
+
     if (queue_thread_.joinable())
         queue_thread_.join();
+
+    // Messages left in queue (e. g. posted while core finalizes videos on stop) are sent after restart
+    std::lock_guard lock(queue_mutex_);
+    size_t stored = 0;
+    for (auto& queue : messages_queues_) {
+        for (const auto& queued : queue) {
+            // Resend store keeps single files, so whole video is stored as its parts
+            const auto video = std::get_if<telegram::messages::Video>(&queued.message);
+            if (video && video->part_number == 0) {
+                if (std::filesystem::exists(video->file_path)) {
+                    for (const auto& part : GetVideoParts(*video))
+                        message_sender_.Store(part);
+                }
+            } else {
+                message_sender_.Store(queued.message);
+            }
+        }
+        stored += queue.size();
+        queue.clear();
+    }
+    if (stored > 0)
+        LOG_INFO << "Messages not sent before stop are put into resend queue: " << stored;
 }
 
 }  // namespace telegram
@@ -1,10 +1,16 @@
 #pragma once
 
+#include "archive_index.h"
+#include "recordings_index.h"
+#include "settings.h"
+#include "telegram_command_executor.h"
 #include "telegram_messages.h"
 #include "telegram_messages_sender.h"
 
 #include <tgbot/tgbot.h>
 
+#include <array>
+#include <chrono>
 #include <deque>
 #include <filesystem>
 #include <memory>
@@ -13,6 +19,7 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace telegram {
 
@@ -23,7 +30,10 @@ struct Filter {
 
 class BotFacade final {
 public:
-    BotFacade(const std::string& token, std::filesystem::path storage_path, std::set<uint64_t> allowed_users, std::set<uint64_t> admin_users);
+    BotFacade(const std::string& token, const std::string& api_url, std::filesystem::path storage_path, std::set<uint64_t> allowed_users, std::set<uint64_t> admin_users,
+              std::shared_ptr<const RecordingsIndex> recordings_index, size_t send_workers,
+              const Settings::TelegramRateLimitSettings& rate_limit_settings, std::chrono::milliseconds media_group_window,
+              size_t command_workers);
     ~BotFacade();
 
     BotFacade(const BotFacade&) = delete;
@@ -34,28 +44,40 @@ public:
     void Start();
     void Stop();
 
+    void SetArchiveIndex(std::shared_ptr<const ArchiveIndex> archive_index);  // Should be called before Start()
+
     // Post to sending queue - thread safe
     // user_id is the explicit recipient. If supplied and user is paused - the message still will be sent
-    void PostOnDemandPhoto(const std::filesystem::path& file_path);  // No user id - waiting users are stored in 'users_waiting_for_photo_'
-    void PostAlarmPhoto(const std::filesystem::path& file_path, const std::string& classes_detected);  // No user id - goes to all users
+    void PostOnDemandPhoto(std::set<uint64_t> recipients, const std::filesystem::path& file_path, telegram::messages::ImageData image);
+    void PostAlarmPhoto(const std::filesystem::path& file_path, const std::string& classes_detected, telegram::messages::ImageData image);  // No user id - goes to all users
     void PostTextMessage(const std::string& message, const std::optional<uint64_t>& user_id = std::nullopt);
     void PostVideoPreview(const std::filesystem::path& file_path, const std::optional<uint64_t>& user_id = std::nullopt);
     void PostVideo(const std::filesystem::path& file_path, const std::optional<uint64_t>& user_id = std::nullopt);
+    void PostVideoPart(const std::filesystem::path& file_path, size_t part_number);
     void PostMenu(uint64_t user_id);
     void PostAdminMenu(uint64_t user_id);
     void PostAnswerCallback(const std::string& callback_id);
 
     bool SomeoneIsWaitingForPhoto() const;
+    std::set<uint64_t> TakeUsersWaitingForPhoto();  // Recipients of on-demand photo, the photo is posted later
 
 private:
+    void Enqueue(Message message);
+    void Enqueue(Message message, Priority priority);  // Queued after messages of this priority, regardless of its type
     void PostStatusMessage(const std::string& message, uint64_t user_id);
+    void PostTextLines(const std::vector<std::string>& lines, uint64_t user_id);
 
     void SetupBotCommands();
+    // Handlers are executed by command executor, so the poll thread only receives updates
+    TgBot::EventBroadcaster::MessageListener Dispatch(TgBot::EventBroadcaster::MessageListener handler);
+    TgBot::EventBroadcaster::CallbackQueryListener Dispatch(TgBot::EventBroadcaster::CallbackQueryListener handler);
+    bool IsUserKnown(uint64_t user_id) const;  // Allowed or admin user
     bool IsUserAllowed(uint64_t user_id) const;
     bool IsUserAdmin(uint64_t user_id) const;
 
     void PollThreadFunc(std::stop_token stop_token);
     void QueueThreadFunc(std::stop_token stop_token);
+    bool SplitVideo(const telegram::messages::Video& video, std::chrono::steady_clock::time_point queued_at);
 
     void ProcessOnDemandCmd(uint64_t user_id);
     void ProcessStatusCmd(uint64_t user_id);
@@ -64,8 +86,12 @@ private:
     void ProcessPauseCmd(uint64_t user_id, std::chrono::minutes pause_time);
     void ProcessResumeCmd(uint64_t user_id);
     void ProcessVideoCmd(uint64_t user_id, const std::string& video_uid);
+    void ProcessArchiveCmd(uint64_t user_id, const std::optional<Filter>& filter);
+    void ProcessArchiveSegmentCmd(uint64_t user_id, const std::string& timestamp);
     void ProcessLogCmd(uint64_t user_id);
+    void ProcessMetricsCmd(uint64_t user_id);
 
+    std::vector<RecordingsIndex::Recording> FindRecordings(const std::optional<Filter>& filter) const;
     std::string PrepareStatusInfo(uint64_t requested_by);
     void UpdatePausedUsers();
     void RemoveUserFromPaused(uint64_t user_id);
@@ -73,20 +99,34 @@ private:
 
 #ifdef HAVE_CURL
     TgBot::CurlHttpClient http_client_;
+#else
+    TgBot::BoostHttpOnlySslClient http_client_;
 #endif
     std::unique_ptr<TgBot::Bot> bot_;
     MessagesSender message_sender_;
     std::filesystem::path storage_path_;
     std::set<uint64_t> allowed_users_;
     std::set<uint64_t> admin_users_;
+    std::shared_ptr<const RecordingsIndex> recordings_index_;
+    std::shared_ptr<const ArchiveIndex> archive_index_;  // Continuous recording index, optional
+    const std::chrono::milliseconds media_group_window_;
 
     std::jthread poll_thread_;
+    CommandExecutor command_executor_;
 
     std::set<uint64_t> users_waiting_for_photo_;
     mutable std::mutex photo_mutex_;
 
-    std::deque<Message> messages_queue_;
+    struct QueuedMessage {
+        Message message;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+    // Previews or alarm photos from the head of the queue are merged into a group
+    static Message GroupMedia(Message message, std::deque<QueuedMessage>& queue);
+    // By priority. Videos are split into parts, so more urgent messages are sent between the parts
+    std::array<std::deque<QueuedMessage>, static_cast<size_t>(Priority::kCount)> messages_queues_;
     std::unordered_map<uint64_t, std::chrono::zoned_time<std::chrono::system_clock::duration>> paused_users_;
+    std::mutex paused_users_mutex_;  // Commands of different users are executed concurrently
     std::jthread queue_thread_;
     std::mutex queue_mutex_;
     std::condition_variable queue_cv_;
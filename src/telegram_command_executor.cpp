@@ -0,0 +1,99 @@
+#include "telegram_command_executor.h"
+
+#include "log.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+const size_t kMaxQueuedUserCommands = 8;  // E. g. user taps the same button repeatedly while the command is slow
+
+}  // namespace
+
+namespace telegram {
+
+CommandExecutor::CommandExecutor(size_t workers)
+    : workers_count_(std::max<size_t>(workers, 1)) {
+}
+
+CommandExecutor::~CommandExecutor() {
+    Stop();
+}
+
+void CommandExecutor::Start() {
+    if (!workers_.empty()) {
+        LOG_INFO << "Attempt start() on already running command executor";
+        return;
+    }
+    for (size_t i = 0; i < workers_count_; ++i)
+        workers_.emplace_back(std::bind_front(&CommandExecutor::WorkerFn, this));
+}
+
+void CommandExecutor::Stop() {
+    for (auto& worker : workers_)
+        worker.request_stop();
+    cv_.notify_all();
+    workers_.clear();  // Joined here
+
+    std::lock_guard lock(mutex_);
+    tasks_.clear();
+    ready_users_.clear();
+    queued_ = 0;
+}
+
+bool CommandExecutor::Post(uint64_t user, Task task) {
+    {
+        std::lock_guard lock(mutex_);
+        auto [it, inserted] = tasks_.try_emplace(user);
+        if (it->second.size() >= kMaxQueuedUserCommands) {
+            LOG_WARNING << "Too many queued commands of user " << user << ", command dropped";
+            AppMetrics->Add("telegram_commands_dropped");
+            return false;
+        }
+        it->second.push_back(std::move(task));
+        if (inserted)  // Otherwise user is already either queued or being served
+            ready_users_.push_back(user);
+        AppMetrics->Set("telegram_commands_queued", static_cast<double>(++queued_));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void CommandExecutor::WorkerFn(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, stop_token, [this] { return !ready_users_.empty(); });
+        if (stop_token.stop_requested())
+            break;
+
+        const auto user = ready_users_.front();
+        ready_users_.pop_front();
+        auto& user_tasks = tasks_.at(user);
+        auto task = std::move(user_tasks.front());
+        user_tasks.pop_front();
+        AppMetrics->Set("telegram_commands_queued", static_cast<double>(--queued_));
+        lock.unlock();
+
+        try {
+            task();
+        } catch (std::exception& e) {
+            LOG_EXCEPTION("Exception while executing bot command", e);
+        }
+
+        lock.lock();
+        // User goes to the end of the queue, so users with many commands don't delay the others
+        if (const auto it = tasks_.find(user); it != tasks_.end()) {
+            if (it->second.empty()) {
+                tasks_.erase(it);
+            } else {
+                ready_users_.push_back(user);
+                lock.unlock();
+                cv_.notify_one();
+            }
+        }
+    }
+}
+
+}  // namespace telegram
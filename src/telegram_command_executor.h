@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace telegram {
+
+// Executes bot commands off the poll thread, so a slow command doesn't stop receiving updates. Commands of the same
+// user are executed one by one in order of arrival, different users are served concurrently. Thread safe
+class CommandExecutor final {
+public:
+    using Task = std::function<void()>;
+
+    explicit CommandExecutor(size_t workers);
+    ~CommandExecutor();
+
+    CommandExecutor(const CommandExecutor&) = delete;
+    CommandExecutor(CommandExecutor&&) = delete;
+    CommandExecutor& operator=(const CommandExecutor&) = delete;
+    CommandExecutor& operator=(CommandExecutor&&) = delete;
+
+    void Start();
+    void Stop();  // Commands which are not started yet are discarded
+
+    bool Post(uint64_t user, Task task);  // Returns false if user has too many queued commands, and the command is dropped
+
+private:
+    void WorkerFn(std::stop_token stop_token);
+
+    const size_t workers_count_;
+    std::unordered_map<uint64_t, std::deque<Task>> tasks_;  // By user. User is present while its command is executed
+    std::deque<uint64_t> ready_users_;  // Users with queued commands, and no command being executed
+    size_t queued_{0};
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::vector<std::jthread> workers_;
+};
+
+}  // namespace telegram
@@ -0,0 +1,182 @@
+#include "telegram_file_uploader.h"
+
+#include "final_action.h"
+#include "log.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const size_t kUploadBufferSize = 64 * 1024;  // Curl reads files by chunks of this size
+
+std::atomic<int64_t> bytes_in_flight{0};  // Not yet sent bytes of all uploads in progress
+
+void UpdateBytesInFlight(int64_t delta) {
+    AppMetrics->Set("telegram_upload_bytes_in_flight", static_cast<double>(bytes_in_flight += delta));
+}
+
+// File or memory buffer being uploaded, read by curl from its own thread context
+struct UploadSource {
+    std::ifstream stream;
+    std::shared_ptr<const std::vector<unsigned char>> data;
+    size_t data_offset{0};
+    int64_t size{0};
+    int64_t bytes_left{0};  // Accounted in bytes in flight
+};
+
+void SetBytesLeft(UploadSource* source, int64_t bytes_left) {
+    UpdateBytesInFlight(bytes_left - source->bytes_left);
+    source->bytes_left = bytes_left;
+}
+
+size_t ReadCallback(char* buffer, size_t size, size_t nitems, void* arg) {
+    auto* source = static_cast<UploadSource*>(arg);
+    int64_t bytes_read = 0;
+    if (source->data) {
+        bytes_read = static_cast<int64_t>(std::min(size * nitems, source->data->size() - source->data_offset));
+        std::copy_n(source->data->data() + source->data_offset, bytes_read, buffer);
+        source->data_offset += static_cast<size_t>(bytes_read);
+    } else {
+        source->stream.read(buffer, static_cast<std::streamsize>(size * nitems));
+        bytes_read = source->stream.gcount();
+        if (bytes_read == 0 && source->stream.bad())
+            return CURL_READFUNC_ABORT;
+    }
+    SetBytesLeft(source, source->bytes_left - bytes_read);
+    return static_cast<size_t>(bytes_read);
+}
+
+int SeekCallback(void* arg, curl_off_t offset, int origin) {
+    // Curl rewinds the data on retries, e. g. after redirect, so the rewound bytes are in flight again
+    auto* source = static_cast<UploadSource*>(arg);
+    if (origin != SEEK_SET)
+        return CURL_SEEKFUNC_CANTSEEK;
+    if (offset < 0 || offset > source->size)
+        return CURL_SEEKFUNC_FAIL;
+    if (source->data) {
+        source->data_offset = static_cast<size_t>(offset);
+    } else {
+        source->stream.clear();
+        source->stream.seekg(offset);
+        if (!source->stream)
+            return CURL_SEEKFUNC_FAIL;
+    }
+    SetBytesLeft(source, source->size - offset);
+    return CURL_SEEKFUNC_OK;
+}
+
+size_t WriteCallback(char* contents, size_t size, size_t nmemb, void* userp) {
+    static_cast<std::string*>(userp)->append(contents, size * nmemb);
+    return size * nmemb;
+}
+
+static const auto curl_deleter = [](CURL* curl) {
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+};
+
+}  // namespace
+
+namespace telegram {
+
+FileUploader::FileUploader(const std::string& api_url, const std::string& token)
+    : url_(api_url + "/bot" + token + "/") {
+    curl_global_init(CURL_GLOBAL_ALL);
+}
+
+FileUploader::~FileUploader() {
+    handles_.clear();
+    curl_global_cleanup();
+}
+
+FileUploader::curl_ptr FileUploader::AcquireHandle() {
+    {
+        std::lock_guard lock(handles_mutex_);
+        if (!handles_.empty()) {
+            auto curl = std::move(handles_.back());
+            handles_.pop_back();
+            curl_easy_reset(curl.get());
+            return curl;
+        }
+    }
+
+    auto curl = curl_ptr(curl_easy_init(), curl_deleter);
+    if (!curl) {
+        LOG_ERROR_EX << "curl init failed";
+        throw std::runtime_error("curl init failed");
+    }
+    return curl;
+}
+
+void FileUploader::ReleaseHandle(curl_ptr curl) {
+    std::lock_guard lock(handles_mutex_);
+    handles_.push_back(std::move(curl));
+}
+
+nlohmann::json FileUploader::Call(const std::string& method, const std::vector<Arg>& args, const std::vector<File>& files) {
+    auto curl = AcquireHandle();
+    auto mime = curl_mime_init(curl.get());
+    const auto _ = FinalAction([&mime] { curl_mime_free(mime); });
+
+    for (const auto& arg : args) {
+        auto part = curl_mime_addpart(mime);
+        curl_mime_name(part, arg.name.c_str());
+        curl_mime_data(part, arg.value.c_str(), arg.value.size());
+    }
+
+    std::vector<std::unique_ptr<UploadSource>> sources;
+    const auto sources_cleanup = FinalAction([&sources] {
+        for (const auto& source : sources)
+            UpdateBytesInFlight(-source->bytes_left);  // Upload is interrupted
+    });
+    for (const auto& file : files) {
+        auto source = std::make_unique<UploadSource>();
+        uintmax_t size = 0;
+        if (file.data) {
+            source->data = file.data;
+            size = file.data->size();
+        } else {
+            source->stream.open(file.file_path, std::ios::binary);
+            std::error_code ec;
+            size = std::filesystem::file_size(file.file_path, ec);
+            if (!source->stream || ec)
+                throw std::runtime_error("Unable to open file for upload: " + file.file_path.generic_string());
+        }
+        source->size = static_cast<int64_t>(size);
+        SetBytesLeft(source.get(), source->size);
+
+        auto part = curl_mime_addpart(mime);
+        curl_mime_name(part, file.name.c_str());
+        curl_mime_filename(part, file.file_path.filename().generic_string().c_str());
+        curl_mime_type(part, file.mime_type.c_str());
+        curl_mime_data_cb(part, static_cast<curl_off_t>(size), ReadCallback, SeekCallback, nullptr, source.get());
+        sources.push_back(std::move(source));
+    }
+
+    const auto url = url_ + method;
+    std::string response;
+    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl.get(), CURLOPT_MIMEPOST, mime);
+    curl_easy_setopt(curl.get(), CURLOPT_UPLOAD_BUFFERSIZE, static_cast<long>(kUploadBufferSize));
+    curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 20L);
+    curl_easy_setopt(curl.get(), CURLOPT_LOW_SPEED_LIMIT, 1L);  // Abort stalled uploads, big files might take long anyway
+    curl_easy_setopt(curl.get(), CURLOPT_LOW_SPEED_TIME, 60L);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, WriteCallback);
+
+    const auto curl_res = curl_easy_perform(curl.get());
+    ReleaseHandle(std::move(curl));
+    if (curl_res != CURLE_OK)
+        throw std::runtime_error(std::string("Bot API request failed: ") + curl_easy_strerror(curl_res));
+
+    const auto json = nlohmann::json::parse(response);
+    if (!json.value("ok", false))
+        throw std::runtime_error(method + " failed: " + json.value("description", std::string("unknown error")));
+    return json.at("result");
+}
+
+}  // namespace telegram
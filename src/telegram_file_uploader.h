@@ -0,0 +1,53 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace telegram {
+
+// Calls Bot API methods with multipart requests. Files are streamed from disk in small chunks by curl, so memory usage
+// doesn't depend on file size (tgbot-cpp reads the whole file into memory for every upload). Thread safe, curl handles
+// are reused to keep connections alive
+class FileUploader final {
+    using curl_ptr = std::unique_ptr<CURL, void(*)(CURL*)>;
+
+public:
+    struct Arg {
+        std::string name;
+        std::string value;
+    };
+    struct File {
+        std::string name;  // Field name, or attach name for media groups
+        std::filesystem::path file_path;
+        std::string mime_type;
+        std::shared_ptr<const std::vector<unsigned char>> data;  // Uploaded instead of the file content if set
+    };
+
+    FileUploader(const std::string& api_url, const std::string& token);  // api_url is e. g. "https://api.telegram.org"
+    ~FileUploader();
+
+    FileUploader(const FileUploader&) = delete;
+    FileUploader(FileUploader&&) = delete;
+    FileUploader& operator=(const FileUploader&) = delete;
+    FileUploader& operator=(FileUploader&&) = delete;
+
+    // Returns "result" of the response. Throws on error, with server description (e. g. "retry after" is kept)
+    nlohmann::json Call(const std::string& method, const std::vector<Arg>& args, const std::vector<File>& files);
+
+private:
+    curl_ptr AcquireHandle();
+    void ReleaseHandle(curl_ptr curl);
+
+    const std::string url_;
+    std::vector<curl_ptr> handles_;  // Idle handles
+    std::mutex handles_mutex_;
+};
+
+}  // namespace telegram
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <set>
 #include <string>
 #include <variant>
+#include <vector>
 
 namespace telegram {
 
@@ -16,18 +18,28 @@ inline const auto kVideo = std::string("video");
 inline const auto kImage = std::string("image");
 inline const auto kPing = std::string("ping");
 inline const auto kLog = std::string("log");
+inline const auto kMetrics = std::string("metrics");
 inline const auto kPause = std::string("pause");
 inline const auto kResume = std::string("resume");
+inline const auto kArchive = std::string("archive");
 
 inline std::string VideoCmdPrefix() {
     auto video_prefix = "/" + kVideo + "_";
     return video_prefix;
 }
 
+inline std::string ArchiveCmdPrefix() {
+    auto archive_prefix = "/" + kArchive + "_";
+    return archive_prefix;
+}
+
 }  // namespace commands
 
 namespace messages {
 
+// Encoded photo, shared by all recipients. File is written in background, and might be not written at all
+using ImageData = std::shared_ptr<const std::vector<unsigned char>>;
+
 struct MultipleRecipients {
     std::set<uint64_t> recipients;
 };
@@ -38,19 +50,36 @@ struct TextMessage : public MultipleRecipients {
 
 struct OnDemandPhoto : public MultipleRecipients {
     std::filesystem::path file_path;
+    ImageData image;  // Sent instead of the file if present
 };
 
 struct AlarmPhoto : public MultipleRecipients {
     std::filesystem::path file_path;
     std::string detections;
+    size_t superseded_alarms{0};  // Alarms collapsed into this one, while sending failed
+    std::string superseded_since;  // Time of the first collapsed alarm
+    ImageData image;  // Sent instead of the file if present
 };
 
 struct Preview : public MultipleRecipients {
     std::filesystem::path file_path;
 };
 
+// Messages of the same type queued together are sent as an album, to cut the number of API calls and notifications
+inline const size_t kMaxMediaGroupSize = 10;  // Bot API limit
+
+struct AlarmPhotoGroup : public MultipleRecipients {
+    std::vector<AlarmPhoto> alarms;  // Recipients of the group are used
+};
+
+struct PreviewGroup : public MultipleRecipients {
+    std::vector<std::filesystem::path> file_paths;
+};
+
 struct Video : public MultipleRecipients {
     std::filesystem::path file_path;
+    size_t part_number{0};  // 0 - whole video with all its parts, otherwise file_path is a single part
+    size_t total_parts{0};  // Single part only, 0 - unknown (the rest of the video is still being recorded)
 };
 
 struct Menu {
@@ -75,7 +104,45 @@ using Message = std::variant<
     telegram::messages::Video,
     telegram::messages::Menu,
     telegram::messages::AdminMenu,
-    telegram::messages::Answer>;
+    telegram::messages::Answer,
+    telegram::messages::AlarmPhotoGroup,
+    telegram::messages::PreviewGroup>;
+
+// Messages are sent in priority order, the most urgent first
+enum class Priority {
+    kAlarm,  // Alarm and on-demand photos
+    kInteractive,  // Text, menus, answers
+    kPreview,
+    kVideo,
+    kCount
+};
+
+inline Priority GetPriority(const Message& message) {
+    if (std::holds_alternative<messages::AlarmPhoto>(message) || std::holds_alternative<messages::AlarmPhotoGroup>(message)
+        || std::holds_alternative<messages::OnDemandPhoto>(message)) {
+        return Priority::kAlarm;
+    }
+    if (std::holds_alternative<messages::Preview>(message) || std::holds_alternative<messages::PreviewGroup>(message))
+        return Priority::kPreview;
+    if (std::holds_alternative<messages::Video>(message))
+        return Priority::kVideo;
+    return Priority::kInteractive;
+}
+
+inline std::string GetPriorityName(Priority priority) {
+    switch (priority) {
+    case Priority::kAlarm:
+        return "alarm";
+    case Priority::kInteractive:
+        return "interactive";
+    case Priority::kPreview:
+        return "preview";
+    case Priority::kVideo:
+        return "video";
+    default:
+        return "unknown";
+    }
+}
 
 }  // namespace telegram
 
@@ -2,12 +2,19 @@
 
 #include "helpers.h"
 #include "log.h"
+#include "metrics.h"
 #include "translation.h"
 #include "uid_utils.h"
 #include "video_utils.h"
 #include "video_writer.h"
 
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
 #include <filesystem>
+#include <latch>
+#include <type_traits>
 
 namespace {
 
@@ -81,244 +88,444 @@ TgBot::InlineKeyboardMarkup::Ptr MakeAdminStartMenu() {
         row.emplace_back(new TgBot::InlineKeyboardButton());
         row.back()->text = kLog;
         row.back()->callbackData = "/" + telegram::commands::kLog;
+        row.emplace_back(new TgBot::InlineKeyboardButton());
+        row.back()->text = kMetrics;
+        row.back()->callbackData = "/" + telegram::commands::kMetrics;
         keyboard->inlineKeyboard.push_back(std::move(row));
     }
     return keyboard;
 }
 
-std::string updateCaption(const std::string& caption, int retryNumber) {
+std::string updateCaption(const std::string& caption, size_t retryNumber) {
     if (retryNumber > 0) {
         return caption + " (retry " + std::to_string(retryNumber) + ")";
     }
     return caption;
 }
 
+const size_t kMaxCachedFileIds = 256;
+const std::string kResendQueueFileName = "resend_queue.json";
+
+void UpdateDeliveryLatency(std::chrono::steady_clock::duration latency) {
+    // Histogram buckets, the last one is unbounded
+    static const std::array<int64_t, 6> kBucketsMs{250, 500, 1'000, 2'000, 5'000, 10'000};
+    const auto latency_ms = std::chrono::duration_cast<std::chrono::milliseconds>(latency).count();
+    const auto bucket = std::find_if(begin(kBucketsMs), end(kBucketsMs), [latency_ms](int64_t b) { return latency_ms <= b; });
+    AppMetrics->Add(bucket == end(kBucketsMs) ? "telegram_delivery_ms_inf" : "telegram_delivery_ms_le_" + std::to_string(*bucket));
+}
+
+std::string GetFileId(const nlohmann::json& message) {
+    if (const auto it = message.find("photo"); it != message.end() && !it->empty())
+        return it->back().value("file_id", std::string());  // The largest size
+    if (const auto it = message.find("video"); it != message.end())
+        return it->value("file_id", std::string());
+    if (const auto it = message.find("document"); it != message.end())
+        return it->value("file_id", std::string());  // Video might be sent as a document if it's not recognized
+    return {};
+}
+
+std::vector<telegram::FileUploader::Arg> MakeCaptionArgs(const std::string& caption) {
+    if (caption.empty())
+        return {};
+    return {{"caption", caption}, {"parse_mode", "HTML"}};
+}
+
 }  // namespace
 
 namespace telegram {
 
-MessagesSender::MessagesSender(TgBot::Bot* bot, std::filesystem::path storage_path)
+MessagesSender::MessagesSender(TgBot::Bot* bot, const std::string& api_url, std::filesystem::path storage_path, size_t send_workers,
+                               const Settings::TelegramRateLimitSettings& rate_limit_settings)
     : bot_{bot}
     , storage_path_{std::move(storage_path)}
     , start_menu_{MakeStartMenu()}
     , admin_start_menu_{MakeAdminStartMenu()}
-    , resend_thread_{&MessagesSender::ResendFn, this} {
+    , rate_limiter_{rate_limit_settings}
+    , uploader_{api_url, bot ? bot->getToken() : std::string()}
+    , resend_store_{storage_path_ / kResendQueueFileName} {
     if (!bot_) {
         static const auto err_msg = "Invalid tg bot dependency";
         LOG_ERROR_EX << err_msg;
         throw std::runtime_error(err_msg);
     }
+
+    resend_thread_ = std::jthread(std::bind_front(&MessagesSender::ResendFn, this));
+
+    // Calling thread sends too, so single worker means sequential sending
+    for (size_t i = 1; i < send_workers; ++i)
+        workers_.emplace_back(std::bind_front(&MessagesSender::WorkerFn, this));
 }
 
 MessagesSender::~MessagesSender() {
+    rate_limiter_.Stop();
+
     const auto resend_stop_requested = resend_thread_.request_stop();
     if (!resend_stop_requested)
         LOG_ERROR << "Resend thread stop request failed";
 
     if (resend_thread_.joinable())
         resend_thread_.join();
+
+    for (auto& worker : workers_)
+        worker.request_stop();
+    tasks_cv_.notify_all();
+    workers_.clear();  // Joined here
+}
+
+void MessagesSender::WorkerFn(std::stop_token stop_token) {
+    while (true) {
+        std::unique_lock lock(tasks_mutex_);
+        tasks_cv_.wait(lock, stop_token, [this] { return !tasks_.empty(); });
+        if (tasks_.empty())  // Stop is requested
+            break;
+
+        auto task = std::move(tasks_.front());
+        tasks_.pop_front();
+        lock.unlock();
+
+        task();
+    }
+}
+
+void MessagesSender::SendToRecipients(const std::vector<uint64_t>& users, const SendToUserFn& send_fn, std::chrono::steady_clock::time_point start) {
+    if (users.empty())
+        return;
+
+    std::latch done(static_cast<std::ptrdiff_t>(users.size()));
+    const auto send = [&](uint64_t user) {
+        send_fn(user);
+        UpdateDeliveryLatency(std::chrono::steady_clock::now() - start);
+        done.count_down();
+    };
+
+    if (!workers_.empty()) {
+        std::lock_guard lock(tasks_mutex_);
+        for (size_t i = 1; i < users.size(); ++i)
+            tasks_.push_back([&send, user = users[i]] { send(user); });
+    }
+    if (users.size() > 1)
+        tasks_cv_.notify_all();
+
+    send(users.front());
+    if (workers_.empty()) {
+        for (size_t i = 1; i < users.size(); ++i)
+            send(users[i]);
+    }
+    done.wait();
 }
 
 void MessagesSender::ResendFn(std::stop_token stop_token) {
-    static const int MaxQueueNotificationCounter = 8;
+    static const int MaxQueueNotificationCounter = 120;
     int queueNotificationCounter = MaxQueueNotificationCounter;
     while (!stop_token.stop_requested()) {
-        std::this_thread::sleep_for(std::chrono::seconds(15));
+        std::this_thread::sleep_for(std::chrono::seconds(1));
 
         if (stop_token.stop_requested())
             break;
 
-        std::lock_guard lock(resend_mutex_);
-        while (!resend_queue_.empty()) {
-            const auto& fn = resend_queue_.front();
+        // Network calls are made without lock, so new failures are added meanwhile
+        std::vector<uint64_t> sent_ids;
+        std::vector<uint64_t> failed_ids;
+        for (const auto& item : resend_store_.GetDue(ResendStore::Clock::now())) {
+            if (stop_token.stop_requested())
+                break;
+
             bool send_result = false;
             try {
-                LOG_DEBUG << "Resending message from resend queue";
-                send_result = fn();
-                if (send_result) {
-                    LOG_DEBUG << "Resend succeeded";
-                }
+                LOG_DEBUG << "Resending message to user " << item.user << ", attempt " << item.attempts;
+                send_result = Send(item.user, item.message, item.attempts);
             } catch (std::exception& e) {
                 LOG_EXCEPTION("Exception while sending message from resend queue", e);
             }
 
-            if (!send_result) {
-                LOG_DEBUG << "Resend failed";
-                break;
-            }
-            resend_queue_.pop_front();
+            LOG_DEBUG << (send_result ? "Resend succeeded" : "Resend failed");
+            (send_result ? sent_ids : failed_ids).push_back(item.id);
         }
+        resend_store_.Complete(sent_ids, failed_ids);
 
+        const auto queue_size = resend_store_.Size();
+        AppMetrics->Set("telegram_resend_queue_size", static_cast<double>(queue_size));
         --queueNotificationCounter;
         if (queueNotificationCounter == 0) {
-            LOG_DEBUG << "Resend queue size: " << resend_queue_.size();
+            LOG_DEBUG << "Resend queue size: " << queue_size;
             queueNotificationCounter = MaxQueueNotificationCounter;
         }
     }
 }
 
-void MessagesSender::operator()(const telegram::messages::TextMessage& message) {
-    std::vector<std::function<bool()>> resend_pack;
-    for (const auto& user : message.recipients) {
-        auto fn = [bot = bot_, user, text = message.text, retryNo = 0]() mutable -> bool {
-            const auto textWithInfo = updateCaption(text, retryNo);
-            ++retryNo;
-            return bot->getApi().sendMessage(user, textWithInfo, nullptr, nullptr, nullptr, "HTML") != nullptr;
-        };
-
+void MessagesSender::FanOut(const std::set<uint64_t>& recipients, const Message& message, const std::filesystem::path& upload_file_path,
+                            const std::string& description) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto send = [&](uint64_t user) {
         bool send_result = false;
         try {
-            send_result = fn();
+            send_result = Send(user, message, 0);
             if (!send_result)
-                LOG_ERROR_EX << "Message send failed to user " << user;
+                LOG_ERROR_EX << description << " send failed to user " << user;
         } catch (std::exception& e) {
-            LOG_EXCEPTION("Exception while sending message", e);
+            LOG_EXCEPTION("Exception while sending " + description, e);
         }
 
         if (!send_result) {
-            resend_pack.push_back(std::move(fn));
+            LOG_DEBUG << "Add to resend queue";
+            resend_store_.Add(user, message);
         }
-    }
+    };
 
-    if (!resend_pack.empty()) {
-        std::lock_guard lock(resend_mutex_);
-        resend_queue_.insert(resend_queue_.end(), std::make_move_iterator(std::begin(resend_pack)), std::make_move_iterator(std::end(resend_pack)));
+    auto it = recipients.begin();
+    if (!upload_file_path.empty()) {
+        for (; it != recipients.end() && !GetCachedFileId(upload_file_path); ++it)
+            SendToRecipients({*it}, send, start);
     }
+    SendToRecipients({it, recipients.end()}, send, start);
 }
 
-void MessagesSender::operator()(const telegram::messages::OnDemandPhoto& message) {
-    const auto& file_path = message.file_path;
-    LOG_DEBUG << "Sending on-demand photo to " << LOG_VAR(message.recipients.size()) << " users: " << file_path;
-    if (!std::filesystem::exists(file_path)) {
-        LOG_ERROR_EX << "On-demand photo file is missing: " << file_path;
-        return;
+bool MessagesSender::Send(uint64_t user, const Message& message, size_t retry_no) {
+    return std::visit([&](const auto& m) {
+        using T = std::decay_t<decltype(m)>;
+        if constexpr (std::is_same_v<T, messages::Menu> || std::is_same_v<T, messages::AdminMenu> || std::is_same_v<T, messages::Answer>) {
+            return true;  // Replies to user actions are sent directly, and never resent
+        } else {
+            return SendTo(user, m, retry_no);
+        }
+    }, message);
+}
+
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::TextMessage& message, size_t retry_no) {
+    const auto textWithInfo = updateCaption(message.text, retry_no);
+    return SendRateLimited(user, [&] {
+        return bot_->getApi().sendMessage(user, textWithInfo, nullptr, nullptr, nullptr, "HTML");
+    }) != nullptr;
+}
+
+bool MessagesSender::SendFileTo(uint64_t user, const std::string& method, const std::string& field, const std::filesystem::path& file_path,
+                                const std::string& mime_type, std::vector<FileUploader::Arg> args, const messages::ImageData& image) {
+    if (!image && !std::filesystem::exists(file_path)) {
+        // E. g. deleted by storage retention before resend, nothing to retry
+        LOG_ERROR_EX << "File is missing: " << file_path;
+        return true;
     }
 
-    const auto photo = TgBot::InputFile::fromFile(file_path.generic_string(), "image/jpeg");
-    const auto caption = "&#128064; " + GetHumanDateTime(file_path.filename().generic_string());  // &#128064; - eyes
+    args.push_back({"chat_id", std::to_string(user)});
+    std::vector<FileUploader::File> files;
+    const auto file_id = GetCachedFileId(file_path);
+    if (file_id) {
+        args.push_back({field, *file_id});
+    } else {
+        files.push_back({field, file_path, mime_type, image});
+    }
 
-    std::vector<std::function<bool()>> resend_pack;
-    for (const auto& user : message.recipients) {
-        auto fn = [bot = bot_, user, photo, caption = caption, retryNo = 0]() mutable -> bool {
-            const auto captionWithInfo = updateCaption(caption, retryNo);
-            ++retryNo;
-            return bot->getApi().sendPhoto(user, photo, captionWithInfo, 0, nullptr, "HTML") != nullptr;
-        };
+    const auto message = SendRateLimited(user, [&] { return uploader_.Call(method, args, files); });
+    if (message.is_null())
+        return false;
 
-        bool send_result = false;
-        try {
-            send_result = fn();
-            if (!send_result)
-                LOG_ERROR_EX << "On-demand photo send failed to user " << user;
-        } catch (std::exception& e) {
-            LOG_EXCEPTION("Exception while sending photo", e);
-        }
+    if (const auto new_file_id = GetFileId(message); !new_file_id.empty() && new_file_id != file_id)
+        CacheFileId(file_path, new_file_id);
+    return true;
+}
 
-        if (!send_result) {
-            LOG_DEBUG << "Add to resend queue";
-            resend_pack.push_back(std::move(fn));
+std::optional<std::string> MessagesSender::GetCachedFileId(const std::filesystem::path& file_path) {
+    std::lock_guard lock(file_ids_mutex_);
+    const auto it = file_ids_.find(file_path.generic_string());
+    if (it == file_ids_.end())
+        return std::nullopt;
+    return it->second;
+}
+
+void MessagesSender::CacheFileId(const std::filesystem::path& file_path, const std::string& file_id) {
+    std::lock_guard lock(file_ids_mutex_);
+    auto key = file_path.generic_string();
+    if (!file_ids_.contains(key)) {
+        if (file_ids_order_.size() >= kMaxCachedFileIds) {
+            file_ids_.erase(file_ids_order_.front());
+            file_ids_order_.pop_front();
         }
+        file_ids_order_.push_back(key);
     }
+    file_ids_[std::move(key)] = file_id;
+}
 
-    if (!resend_pack.empty()) {
-        std::lock_guard lock(resend_mutex_);
-        resend_queue_.insert(resend_queue_.end(), std::make_move_iterator(std::begin(resend_pack)), std::make_move_iterator(std::end(resend_pack)));
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::OnDemandPhoto& message, size_t retry_no) {
+    const auto caption = "&#128064; " + GetHumanDateTime(message.file_path.filename().generic_string());  // &#128064; - eyes
+    return SendFileTo(user, "sendPhoto", "photo", message.file_path, "image/jpeg", MakeCaptionArgs(updateCaption(caption, retry_no)), message.image);
+}
+
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::AlarmPhoto& message, size_t retry_no) {
+    auto caption = "&#10071; " + GetHumanDateTime(message.file_path.filename().generic_string())  // &#10071; - red exclamation mark
+                   + (message.detections.empty() ? "" : " (" + message.detections + ")");
+    if (message.superseded_alarms > 0) {
+        caption += ", +" + std::to_string(message.superseded_alarms) + " " + translation::messages::kMoreAlarmsSince + " "
+                   + message.superseded_since;
     }
+    return SendFileTo(user, "sendPhoto", "photo", message.file_path, "image/jpeg", MakeCaptionArgs(updateCaption(caption, retry_no)), message.image);
 }
 
-void MessagesSender::operator()(const telegram::messages::AlarmPhoto& message) {
-    const auto& file_path = message.file_path;
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::Preview& message, size_t retry_no) {
+    const auto file_name = message.file_path.filename().generic_string();
+    const auto uid = GetUidFromFileName(file_name);
+    const auto video_file_path = storage_path_ / VideoWriter::GenerateVideoFileName(uid);
 
-    if (!std::filesystem::exists(file_path)) {
-        LOG_ERROR_EX << "Alarm photo file is missing: " << file_path;
-        return;
+    if (!std::filesystem::exists(video_file_path)) {
+        LOG_ERROR_EX << "Video file is missing: " << LOG_VAR(uid);
+        return true;
     }
 
-    const auto photo = TgBot::InputFile::fromFile(file_path.generic_string(), "image/jpeg");
-    const auto caption = "&#10071; " + GetHumanDateTime(file_path.filename().generic_string())  // &#10071; - red exclamation mark
-                         + (message.detections.empty() ? "" : " (" + message.detections + ")");
+    const auto cmd = telegram::commands::VideoCmdPrefix() + uid;
 
-    std::vector<std::function<bool()>> resend_pack;
-    for (const auto& user : message.recipients) {
-        auto fn = [bot = bot_, user, photo, caption = caption, retryNo = 0]() mutable -> bool {
-            const auto captionWithInfo = updateCaption(caption, retryNo);
-            ++retryNo;
-            return bot->getApi().sendPhoto(user, photo, captionWithInfo, 0, nullptr, "HTML") != nullptr;
-        };
+    const auto view_button = nlohmann::json{
+        {"text", GetHumanDateTime(file_name) + " (" + std::to_string(GetFileSizeMb(video_file_path)) + " MB)"},
+        {"callback_data", cmd}
+    };
+    const auto keyboard = nlohmann::json{{"inline_keyboard", nlohmann::json::array({nlohmann::json::array({view_button})})}};
 
-        bool send_result = false;
-        try {
-            send_result = fn();
-            if (!send_result)
-                LOG_ERROR_EX << "Alarm photo send failed to user " << user;
-        } catch (std::exception& e) {
-            LOG_EXCEPTION("Exception while sending photo", e);
-        }
+    auto args = MakeCaptionArgs(updateCaption("", retry_no));
+    args.push_back({"reply_markup", keyboard.dump()});
+    args.push_back({"disable_notification", "true"});  // NOTE: No notification here
+    return SendFileTo(user, "sendPhoto", "photo", message.file_path, "image/jpeg", std::move(args), {});
+}
 
-        if (!send_result) {
-            resend_pack.push_back(std::move(fn));
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::Video& message, size_t retry_no) {
+    // Single part is sent either while the rest of the video is still being recorded (total number of parts is unknown),
+    // or as a part of split video
+    auto caption = "&#127910; " + GetHumanDateTime(message.file_path.filename().generic_string());  // &#127910; - video camera
+    if (message.total_parts > 1) {
+        caption += " (" + std::to_string(message.part_number) + "/" + std::to_string(message.total_parts) + ")";
+    } else if (message.total_parts == 0) {
+        caption += " (" + std::to_string(message.part_number) + ")";
+    }
+
+    return SendFileTo(user, "sendVideo", "video", message.file_path, "video/mp4", MakeCaptionArgs(updateCaption(caption, retry_no)), {});
+}
+
+bool MessagesSender::SendMediaGroup(uint64_t user, const std::vector<MediaGroupPhoto>& photos, bool disable_notification) {
+    std::vector<FileUploader::Arg> args{{"chat_id", std::to_string(user)}};
+    std::vector<FileUploader::File> files;
+    auto media = nlohmann::json::array();
+    for (size_t i = 0; i < photos.size(); ++i) {
+        const auto& photo = photos[i];
+        auto media_item = nlohmann::json{{"type", "photo"}, {"caption", photo.caption}, {"parse_mode", "HTML"}};
+        if (const auto file_id = GetCachedFileId(photo.file_path)) {
+            media_item["media"] = *file_id;
+        } else {
+            const auto attach_name = "photo" + std::to_string(i);
+            files.push_back({attach_name, photo.file_path, "image/jpeg", photo.image});
+            media_item["media"] = "attach://" + attach_name;
         }
+        media.push_back(std::move(media_item));
     }
+    args.push_back({"media", media.dump()});
+    if (disable_notification)
+        args.push_back({"disable_notification", "true"});
+
+    // Messages of the album are returned in the same order
+    const auto result = uploader_.Call("sendMediaGroup", args, files);
+    for (size_t i = 0; i < photos.size() && i < result.size(); ++i) {
+        if (const auto& sizes = result[i].value("photo", nlohmann::json::array()); !sizes.empty())
+            CacheFileId(photos[i].file_path, sizes.back().at("file_id"));  // The largest size
+    }
+    return true;
+}
 
-    if (!resend_pack.empty()) {
-        std::lock_guard lock(resend_mutex_);
-        resend_queue_.insert(resend_queue_.end(), std::make_move_iterator(std::begin(resend_pack)), std::make_move_iterator(std::end(resend_pack)));
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::AlarmPhotoGroup& message, size_t retry_no) {
+    std::vector<MediaGroupPhoto> photos;
+    for (const auto& alarm : message.alarms) {
+        if (!alarm.image && !std::filesystem::exists(alarm.file_path)) {
+            LOG_ERROR_EX << "Alarm photo file is missing: " << alarm.file_path;
+            continue;
+        }
+        photos.push_back(MediaGroupPhoto{alarm.file_path, "&#10071; " + GetHumanDateTime(alarm.file_path.filename().generic_string())  // &#10071; - red exclamation mark
+                                                          + (alarm.detections.empty() ? "" : " (" + alarm.detections + ")"), alarm.image});
     }
+    if (photos.empty())
+        return true;
+    photos.front().caption = updateCaption(photos.front().caption, retry_no);
+
+    return SendRateLimited(user, [&] { return SendMediaGroup(user, photos, false); });
 }
 
-void MessagesSender::operator()(const telegram::messages::Preview& message) {
-    const auto& file_path = message.file_path;
+bool MessagesSender::SendTo(uint64_t user, const telegram::messages::PreviewGroup& message, size_t retry_no) {
+    std::vector<MediaGroupPhoto> photos;
+    auto keyboard = std::make_shared<TgBot::InlineKeyboardMarkup>();
+    for (const auto& file_path : message.file_paths) {
+        const auto file_name = file_path.filename().generic_string();
+        const auto uid = GetUidFromFileName(file_name);
+        const auto video_file_path = storage_path_ / VideoWriter::GenerateVideoFileName(uid);
+        if (!std::filesystem::exists(file_path) || !std::filesystem::exists(video_file_path)) {
+            LOG_ERROR_EX << "Preview or video file is missing: " << LOG_VAR(uid);
+            continue;
+        }
 
-    if (!std::filesystem::exists(file_path)) {
-        LOG_ERROR_EX << "Preview file is missing: " << file_path;
-        return;
+        // Album items can't have buttons, so they are numbered and sent as a separate keyboard
+        const auto caption = std::to_string(photos.size() + 1) + ". " + GetHumanDateTime(file_name);
+        auto view_button = std::make_shared<TgBot::InlineKeyboardButton>();
+        view_button->text = caption + " (" + std::to_string(GetFileSizeMb(video_file_path)) + " MB)";
+        view_button->callbackData = telegram::commands::VideoCmdPrefix() + uid;
+        keyboard->inlineKeyboard.push_back({view_button});
+        photos.push_back(MediaGroupPhoto{file_path, caption});
     }
+    if (photos.empty())
+        return true;
 
-    const auto file_name = file_path.filename().generic_string();
-    const auto uid = GetUidFromFileName(file_name);
-    const auto video_file_path = storage_path_ / VideoWriter::GenerateVideoFileName(uid);
+    if (!SendRateLimited(user, [&] { return SendMediaGroup(user, photos, true); }))  // NOTE: No notification here
+        return false;
 
-    if (!std::filesystem::exists(video_file_path)) {
-        LOG_ERROR_EX << "Video file is missing: " << LOG_VAR(uid);
-        return;
+    // Album is delivered already, so keyboard is not resent with it
+    try {
+        const auto keyboard_sent = SendRateLimited(user, [&] {
+            return bot_->getApi().sendMessage(user, updateCaption("&#127910; " + translation::menu::kVideos, retry_no), nullptr, nullptr, keyboard, "HTML", true);
+        });
+        if (!keyboard_sent)
+            LOG_ERROR_EX << "Previews keyboard send failed to user " << user;
+    } catch (std::exception& e) {
+        LOG_EXCEPTION("Exception while sending previews keyboard", e);
     }
+    return true;
+}
 
-    const auto photo = TgBot::InputFile::fromFile(file_path.generic_string(), "image/jpeg");
-    const auto cmd = telegram::commands::VideoCmdPrefix() + uid;
+void MessagesSender::Store(const Message& message) {
+    std::visit([&](const auto& m) {
+        if constexpr (std::is_base_of_v<messages::MultipleRecipients, std::decay_t<decltype(m)>>) {
+            for (const auto user : m.recipients)
+                resend_store_.Add(user, message);
+        }
+    }, message);
+}
 
-    auto keyboard = std::make_shared<TgBot::InlineKeyboardMarkup>();
-    auto view_button = std::make_shared<TgBot::InlineKeyboardButton>();
+void MessagesSender::operator()(const telegram::messages::TextMessage& message) {
+    FanOut(message.recipients, message, {}, "Message");
+}
 
-    view_button->text = GetHumanDateTime(file_name) + " (" + std::to_string(GetFileSizeMb(video_file_path)) + " MB)";
-    view_button->callbackData = cmd;
-    keyboard->inlineKeyboard.push_back({view_button});
+void MessagesSender::operator()(const telegram::messages::OnDemandPhoto& message) {
+    const auto& file_path = message.file_path;
+    LOG_DEBUG << "Sending on-demand photo to " << LOG_VAR(message.recipients.size()) << " users: " << file_path;
+    if (!message.image && !std::filesystem::exists(file_path)) {
+        LOG_ERROR_EX << "On-demand photo file is missing: " << file_path;
+        return;
+    }
 
-    std::vector<std::function<bool()>> resend_pack;
-    for (const auto& user : message.recipients) {
-        auto fn = [bot = bot_, user, photo, keyboard, retryNo = 0]() mutable -> bool {
-            const auto captionWithInfo = updateCaption("", retryNo);
-            ++retryNo;
-            return bot->getApi().sendPhoto(user, photo, captionWithInfo, 0, keyboard, "", true) != nullptr;  // NOTE: No notification here
-        };
+    FanOut(message.recipients, message, file_path, "On-demand photo");
+}
 
-        bool send_result = false;
-        try {
-            send_result = fn();
-            if (!send_result)
-                LOG_ERROR_EX << "Video preview send failed to user " << user;
-        } catch (std::exception& e) {
-            LOG_EXCEPTION("Exception while sending preview", e);
-        }
+void MessagesSender::operator()(const telegram::messages::AlarmPhoto& message) {
+    const auto& file_path = message.file_path;
 
-        if (!send_result) {
-            resend_pack.push_back(std::move(fn));
-        }
+    if (!message.image && !std::filesystem::exists(file_path)) {
+        LOG_ERROR_EX << "Alarm photo file is missing: " << file_path;
+        return;
     }
 
-    if (!resend_pack.empty()) {
-        std::lock_guard lock(resend_mutex_);
-        resend_queue_.insert(resend_queue_.end(), std::make_move_iterator(std::begin(resend_pack)), std::make_move_iterator(std::end(resend_pack)));
+    FanOut(message.recipients, message, file_path, "Alarm photo");
+}
+
+void MessagesSender::operator()(const telegram::messages::Preview& message) {
+    const auto& file_path = message.file_path;
+
+    if (!std::filesystem::exists(file_path)) {
+        LOG_ERROR_EX << "Preview file is missing: " << file_path;
+        return;
     }
+
+    FanOut(message.recipients, message, file_path, "Video preview");
 }
 
 void MessagesSender::operator()(const telegram::messages::Video& message) {
@@ -329,50 +536,24 @@ void MessagesSender::operator()(const telegram::messages::Video& message) {
         return;
     }
 
-    auto splitted_files = GetSplittedFileNames(file_path);
-    const size_t total_parts = splitted_files.size();
-    size_t part_number = 0;
-    std::vector<std::function<bool()>> resend_pack;
-
-    for (const auto& part_file_path : splitted_files) {
-        ++part_number;
-        for (const auto& user : message.recipients) {
-            const auto video = TgBot::InputFile::fromFile(part_file_path.generic_string(), "video/mp4");
-            auto caption = "&#127910; " + GetHumanDateTime(file_path.filename().generic_string());  // &#127910; - video camera
-            if (total_parts > 1) {
-                caption += " (" + std::to_string(part_number) + "/" + std::to_string(total_parts) + ")";
-            }
-
-            auto fn = [bot = bot_, user, video, caption = caption, retryNo = 0]() mutable -> bool {
-                const auto captionWithInfo = updateCaption(caption, retryNo);
-                ++retryNo;
-                return bot->getApi().sendVideo(user, video, false, 0, 0, 0, "", captionWithInfo, 0, nullptr, "HTML") != nullptr;
-            };
-
-            bool send_result = false;
-            try {
-                send_result = fn();
-                if (!send_result)
-                    LOG_ERROR_EX << "Video file " << file_path << " send failed to user " << user;
-            } catch (std::exception& e) {
-                LOG_EXCEPTION("Exception while sending video", e);
-            }
+    // Whole videos are split into parts by bot facade, so only single files are sent here
+    FanOut(message.recipients, message, file_path, "Video part");
+}
 
-            if (!send_result) {
-                resend_pack.push_back(std::move(fn));
-            }
-        }
-    }
+void MessagesSender::operator()(const telegram::messages::AlarmPhotoGroup& message) {
+    FanOut(message.recipients, message, message.alarms.front().file_path, "Alarm photos");
+}
 
-    if (!resend_pack.empty()) {
-        std::lock_guard lock(resend_mutex_);
-        resend_queue_.insert(resend_queue_.end(), std::make_move_iterator(std::begin(resend_pack)), std::make_move_iterator(std::end(resend_pack)));
-    }
+void MessagesSender::operator()(const telegram::messages::PreviewGroup& message) {
+    FanOut(message.recipients, message, message.file_paths.front(), "Video previews");
 }
 
 void MessagesSender::operator()(const telegram::messages::Menu& message) {
     try {
-        if (!bot_->getApi().sendMessage(message.recipient, translation::menu::kCaption, nullptr, nullptr, start_menu_, "HTML"))
+        const auto result = SendRateLimited(message.recipient, [&] {
+            return bot_->getApi().sendMessage(message.recipient, translation::menu::kCaption, nullptr, nullptr, start_menu_, "HTML");
+        });
+        if (!result)
             LOG_ERROR_EX << "/start reply send failed to user " << message.recipient;
     } catch (std::exception& e) {
         LOG_EXCEPTION("Exception while sending menu", e);
@@ -381,7 +562,10 @@ void MessagesSender::operator()(const telegram::messages::Menu& message) {
 
 void MessagesSender::operator()(const telegram::messages::AdminMenu& message) {
     try {
-        if (!bot_->getApi().sendMessage(message.recipient, translation::menu::kCaption, nullptr, nullptr, admin_start_menu_, "HTML"))
+        const auto result = SendRateLimited(message.recipient, [&] {
+            return bot_->getApi().sendMessage(message.recipient, translation::menu::kCaption, nullptr, nullptr, admin_start_menu_, "HTML");
+        });
+        if (!result)
             LOG_ERROR_EX << "/start reply send failed to user " << message.recipient;
     } catch (std::exception& e) {
         LOG_EXCEPTION("Exception while sending admin menu", e);
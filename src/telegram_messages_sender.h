@@ -1,19 +1,31 @@
 #pragma once
 
+#include "settings.h"
+#include "telegram_file_uploader.h"
 #include "telegram_messages.h"
+#include "telegram_rate_limiter.h"
+#include "telegram_resend_store.h"
 
 #include <tgbot/tgbot.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <deque>
 #include <filesystem>
 #include <functional>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace telegram {
 class MessagesSender final {
 public:
-    explicit MessagesSender(TgBot::Bot* bot, std::filesystem::path storage_path);
+    MessagesSender(TgBot::Bot* bot, const std::string& api_url, std::filesystem::path storage_path, size_t send_workers,
+                   const Settings::TelegramRateLimitSettings& rate_limit_settings);
     ~MessagesSender();
 
     void operator()(const telegram::messages::TextMessage& message);
@@ -24,17 +36,80 @@ public:
     void operator()(const telegram::messages::Menu& message);
     void operator()(const telegram::messages::AdminMenu& message);
     void operator()(const telegram::messages::Answer& message);
+    void operator()(const telegram::messages::AlarmPhotoGroup& message);
+    void operator()(const telegram::messages::PreviewGroup& message);
+
+    void Store(const Message& message);  // Not sent message is put into resend queue, e. g. on stop
 
 private:
     TgBot::Bot* const bot_{};
     const std::filesystem::path storage_path_;
     const TgBot::InlineKeyboardMarkup::Ptr start_menu_{};
     const TgBot::InlineKeyboardMarkup::Ptr admin_start_menu_{};
+    RateLimiter rate_limiter_;
+    FileUploader uploader_;  // Files are sent directly, as tgbot-cpp reads the whole file into memory
+
+    // Waits for rate limiter, and postpones further sends to the chat if server responds with 429 error
+    template <typename SendFn>
+    auto SendRateLimited(uint64_t chat_id, const SendFn& send_fn) -> decltype(send_fn()) {
+        if (!rate_limiter_.Acquire(static_cast<int64_t>(chat_id)))
+            return {};  // Stopped, or the chat is paused for long. Send fails, so the message is resent later
+
+        try {
+            return send_fn();
+        } catch (std::exception& e) {
+            if (const auto retry_after = RateLimiter::GetRetryAfter(e.what()))
+                rate_limiter_.Postpone(static_cast<int64_t>(chat_id), *retry_after);
+            throw;
+        }
+    }
+
+    // Sends to all recipients, failed ones are retried later. If upload_file_path is set, the file is uploaded to one
+    // recipient at a time till file_id is known, then the rest of recipients reference it by file_id
+    void FanOut(const std::set<uint64_t>& recipients, const Message& message, const std::filesystem::path& upload_file_path,
+                const std::string& description);
 
-    std::deque<std::function<bool()>> resend_queue_;
+    // Send to a single user, returns false if the message should be resent
+    bool Send(uint64_t user, const Message& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::TextMessage& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::OnDemandPhoto& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::AlarmPhoto& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::Preview& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::Video& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::AlarmPhotoGroup& message, size_t retry_no);
+    bool SendTo(uint64_t user, const telegram::messages::PreviewGroup& message, size_t retry_no);
+    // Sends file with Bot API method (e. g. sendPhoto), the file is referenced by file_id if it was sent already.
+    // If image is set, it's uploaded instead of the file content
+    bool SendFileTo(uint64_t user, const std::string& method, const std::string& field, const std::filesystem::path& file_path,
+                    const std::string& mime_type, std::vector<FileUploader::Arg> args, const messages::ImageData& image);
+
+    struct MediaGroupPhoto {
+        std::filesystem::path file_path;
+        std::string caption;
+        messages::ImageData image;
+    };
+    bool SendMediaGroup(uint64_t user, const std::vector<MediaGroupPhoto>& photos, bool disable_notification);
+
+    ResendStore resend_store_;
     std::jthread resend_thread_;
-    std::mutex resend_mutex_;
     void ResendFn(std::stop_token stop_token);
+
+    // Message is sent to different recipients concurrently, and the call returns when all recipients are done, so the
+    // order of messages within a chat is kept
+    using SendToUserFn = std::function<void(uint64_t user)>;
+    void SendToRecipients(const std::vector<uint64_t>& users, const SendToUserFn& send_fn, std::chrono::steady_clock::time_point start);
+    void WorkerFn(std::stop_token stop_token);
+    std::vector<std::jthread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex tasks_mutex_;
+    std::condition_variable_any tasks_cv_;
+
+    // Telegram file_id of already sent files, e. g. for repeated video requests
+    std::optional<std::string> GetCachedFileId(const std::filesystem::path& file_path);
+    void CacheFileId(const std::filesystem::path& file_path, const std::string& file_id);
+    std::unordered_map<std::string, std::string> file_ids_;  // By file path
+    std::deque<std::string> file_ids_order_;  // The oldest first
+    std::mutex file_ids_mutex_;
 };
 
 }  // namespace telegram
@@ -0,0 +1,116 @@
+#include "telegram_rate_limiter.h"
+
+#include "log.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <regex>
+
+namespace {
+
+// Longer pause of the chat is not waited for, the message is resent later instead. Sender threads are shared by all
+// chats, so they are not blocked by a single one
+const auto kMaxPauseWait = std::chrono::seconds(5);
+
+}  // namespace
+
+namespace telegram {
+
+RateLimiter::RateLimiter(const Settings::TelegramRateLimitSettings& settings)
+    : settings_(settings)
+    , global_(MakeBucket(settings.messages_per_second, static_cast<size_t>(settings.messages_per_second))) {
+}
+
+RateLimiter::Bucket RateLimiter::MakeBucket(double sends_per_second, size_t burst) const {
+    Bucket bucket;
+    if (sends_per_second > 0.0) {
+        bucket.interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / sends_per_second));
+        bucket.burst = bucket.interval * (std::max<size_t>(burst, 1) - 1);
+    }
+    return bucket;
+}
+
+RateLimiter::Bucket& RateLimiter::GetChatBucket(int64_t chat_id) {
+    auto it = chats_.find(chat_id);
+    if (it == chats_.end()) {
+        // Negative ids are groups and channels
+        const auto bucket = chat_id < 0 ? MakeBucket(settings_.group_messages_per_minute / 60.0, 1) : MakeBucket(settings_.chat_messages_per_second, 1);
+        it = chats_.emplace(chat_id, bucket).first;
+    }
+    return it->second;
+}
+
+RateLimiter::Clock::time_point RateLimiter::Earliest(const Bucket& bucket, Clock::time_point t) {
+    return std::max({t, bucket.tat - bucket.burst, bucket.paused_till});
+}
+
+void RateLimiter::Reserve(Bucket& bucket, Clock::time_point t) {
+    bucket.tat = std::max(bucket.tat, t) + bucket.interval;
+}
+
+bool RateLimiter::Acquire(int64_t chat_id) {
+    if (!settings_.enabled)
+        return true;
+
+    std::unique_lock lock(mutex_);
+    auto& chat = GetChatBucket(chat_id);
+
+    const auto start = Clock::now();
+    auto send_time = start;
+    while (!stopped_) {
+        const auto now = Clock::now();
+        if (chat.paused_till - now > kMaxPauseWait) {
+            LOG_WARNING << "Chat " << chat_id << " is paused, message is deferred";
+            AppMetrics->Add("telegram_rate_limit_deferred");
+            return false;
+        }
+
+        // Slot is reserved when it's taken, so senders waiting for it don't hold slots if sending is paused meanwhile.
+        // The waiters are woken up at the same time, and the rest of them wait for the next slot
+        const auto earliest = std::max(Earliest(global_, now), Earliest(chat, now));
+        if (earliest <= now) {
+            Reserve(global_, now);
+            Reserve(chat, now);
+            send_time = now;
+            break;
+        }
+        cv_.wait_until(lock, earliest, [this] { return stopped_; });
+    }
+    if (stopped_)
+        return false;
+
+    if (send_time > start)
+        AppMetrics->Set("telegram_rate_limit_delay_ms", static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(send_time - start).count()));
+    return true;
+}
+
+void RateLimiter::Postpone(int64_t chat_id, std::chrono::seconds retry_after) {
+    LOG_WARNING << "Bot API rate limit hit, chat " << chat_id << ", retry after " << retry_after.count() << " s";
+    AppMetrics->Add("telegram_rate_limit_errors");
+    std::lock_guard lock(mutex_);
+    // It's not known which limit is hit, so the chat is paused for the whole period, and global sending is paused for a
+    // short while to let buckets drain
+    const auto now = Clock::now();
+    auto& chat = GetChatBucket(chat_id);
+    chat.paused_till = std::max(chat.paused_till, now + retry_after);
+    global_.paused_till = std::max(global_.paused_till, now + std::min<Clock::duration>(retry_after, std::chrono::seconds(1)));
+}
+
+void RateLimiter::Stop() {
+    {
+        std::lock_guard lock(mutex_);
+        stopped_ = true;
+    }
+    cv_.notify_all();
+}
+
+std::optional<std::chrono::seconds> RateLimiter::GetRetryAfter(const std::string& error) {
+    // E. g. "Too Many Requests: retry after 35"
+    static const auto retry_regex = std::regex(R"(retry after (\d+))", std::regex::icase);
+    std::smatch match;
+    if (!std::regex_search(error, match, retry_regex))
+        return std::nullopt;
+    return std::chrono::seconds(std::stoll(match[1].str()));
+}
+
+}  // namespace telegram
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "settings.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace telegram {
+
+// Bot API limits: global and per-chat token buckets (GCRA). Concurrent senders wait for the next free slot, so they are
+// spread over time instead of hitting 429 errors. Thread safe
+class RateLimiter final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RateLimiter(const Settings::TelegramRateLimitSettings& settings);
+
+    bool Acquire(int64_t chat_id);  // Blocks till the send is allowed, returns false if stopped or the chat is paused for long
+    void Postpone(int64_t chat_id, std::chrono::seconds retry_after);  // Server asked to wait
+    void Stop();  // Unblocks waiting senders
+
+    static std::optional<std::chrono::seconds> GetRetryAfter(const std::string& error);  // Parses 429 error description
+
+private:
+    struct Bucket {
+        Clock::duration interval{};  // Between sends
+        Clock::duration burst{};  // Sends allowed ahead of interval
+        Clock::time_point tat{};  // Theoretical arrival time of the next send
+        Clock::time_point paused_till{};
+    };
+
+    Bucket MakeBucket(double sends_per_second, size_t burst) const;
+    Bucket& GetChatBucket(int64_t chat_id);
+    static Clock::time_point Earliest(const Bucket& bucket, Clock::time_point t);
+    static void Reserve(Bucket& bucket, Clock::time_point t);
+
+    const Settings::TelegramRateLimitSettings settings_;
+    Bucket global_;
+    std::unordered_map<int64_t, Bucket> chats_;
+    bool stopped_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+};
+
+}  // namespace telegram
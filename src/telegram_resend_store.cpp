@@ -0,0 +1,283 @@
+#include "telegram_resend_store.h"
+
+#include "log.h"
+#include "uid_utils.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <type_traits>
+
+namespace {
+
+const auto kInitialDelay = std::chrono::seconds(15);
+const auto kMaxDelay = std::chrono::minutes(30);
+const auto kMaxAge = std::chrono::hours(24);  // Older messages are dropped, they are not relevant anymore
+const auto kSaveInterval = std::chrono::seconds(5);  // Changes made meanwhile are lost if the app is killed
+
+int64_t ToSeconds(telegram::ResendStore::Clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+}
+
+telegram::ResendStore::Clock::time_point FromSeconds(int64_t seconds) {
+    return telegram::ResendStore::Clock::time_point(std::chrono::seconds(seconds));
+}
+
+nlohmann::json MessageToJson(const telegram::Message& message) {
+    using namespace telegram::messages;
+    if (const auto text = std::get_if<TextMessage>(&message))
+        return {{"type", "text"}, {"text", text->text}};
+    if (const auto photo = std::get_if<OnDemandPhoto>(&message))
+        return {{"type", "on_demand"}, {"file", photo->file_path.generic_string()}};
+    if (const auto alarm = std::get_if<AlarmPhoto>(&message)) {
+        return {{"type", "alarm"}, {"file", alarm->file_path.generic_string()}, {"detections", alarm->detections},
+                {"superseded", alarm->superseded_alarms}, {"superseded_since", alarm->superseded_since}};
+    }
+    if (const auto preview = std::get_if<Preview>(&message))
+        return {{"type", "preview"}, {"file", preview->file_path.generic_string()}};
+    if (const auto video = std::get_if<Video>(&message)) {
+        return {{"type", "video"}, {"file", video->file_path.generic_string()}, {"part", video->part_number},
+                {"total_parts", video->total_parts}};
+    }
+    throw std::runtime_error("Message type is not resendable");
+}
+
+// Photo sent from memory might be not written to disk, while the queue keeps file path only
+void WriteImage(const telegram::Message& message) {
+    using namespace telegram::messages;
+    std::filesystem::path file_path;
+    ImageData image;
+    if (const auto photo = std::get_if<OnDemandPhoto>(&message)) {
+        file_path = photo->file_path;
+        image = photo->image;
+    } else if (const auto alarm = std::get_if<AlarmPhoto>(&message)) {
+        file_path = alarm->file_path;
+        image = alarm->image;
+    }
+    if (!image || std::filesystem::exists(file_path))
+        return;
+
+    std::ofstream out(file_path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(image->data()), static_cast<std::streamsize>(image->size()));
+    out.close();
+    if (!out)
+        LOG_ERROR_EX << "Unable to write photo to resend, " << LOG_VAR(file_path);
+}
+
+telegram::Message MessageFromJson(const nlohmann::json& json, uint64_t user) {
+    using namespace telegram::messages;
+    const std::string type = json.at("type");
+    const auto recipients = std::set<uint64_t>{user};
+    if (type == "text")
+        return TextMessage{recipients, json.at("text")};
+    if (type == "on_demand")
+        return OnDemandPhoto{recipients, json.at("file").get<std::string>()};
+    if (type == "alarm") {
+        return AlarmPhoto{recipients, json.at("file").get<std::string>(), json.at("detections"), json.at("superseded"),
+                          json.at("superseded_since")};
+    }
+    if (type == "preview")
+        return Preview{recipients, json.at("file").get<std::string>()};
+    if (type == "video")
+        return Video{recipients, json.at("file").get<std::string>(), json.at("part"), json.at("total_parts")};
+    throw std::runtime_error("Unknown message type: " + type);
+}
+
+}  // namespace
+
+namespace telegram {
+
+ResendStore::ResendStore(std::filesystem::path file_path)
+    : file_path_(std::move(file_path)) {
+    Load();
+}
+
+ResendStore::~ResendStore() {
+    std::lock_guard lock(mutex_);
+    if (changed_)
+        Save();
+}
+
+bool ResendStore::IsResendable(const Message& message) {
+    // Menus and answers are replies to user actions, they are useless later
+    return std::holds_alternative<messages::TextMessage>(message) || std::holds_alternative<messages::OnDemandPhoto>(message)
+        || std::holds_alternative<messages::AlarmPhoto>(message) || std::holds_alternative<messages::Preview>(message)
+        || std::holds_alternative<messages::Video>(message);
+}
+
+void ResendStore::Load() {
+    if (!std::filesystem::exists(file_path_))
+        return;
+
+    try {
+        std::ifstream in(file_path_);
+        const auto json = nlohmann::json::parse(in);
+        for (const auto& item_json : json) {
+            const uint64_t user = item_json.at("user");
+            Item item{next_id_++, user, MessageFromJson(item_json.at("message"), user), item_json.at("attempts"),
+                      FromSeconds(item_json.at("created")), FromSeconds(item_json.at("next_attempt"))};
+            items_.emplace(item.id, std::move(item));
+        }
+        LOG_INFO << "Resend queue loaded, messages = " << items_.size();
+    } catch (std::exception& e) {
+        LOG_EXCEPTION("Unable to load resend queue, it's dropped", e);
+        items_.clear();
+    }
+}
+
+void ResendStore::Save() {
+    changed_ = false;
+    saved_at_ = Clock::now();
+
+    auto json = nlohmann::json::array();
+    for (const auto& [id, item] : items_) {
+        json.push_back({{"user", item.user}, {"message", MessageToJson(item.message)}, {"attempts", item.attempts},
+                        {"created", ToSeconds(item.created)}, {"next_attempt", ToSeconds(item.next_attempt)}});
+    }
+
+    // Written to temporary file first, so the queue is not lost if the app is killed while writing
+    auto tmp_file_path = file_path_;
+    tmp_file_path += ".tmp";
+    {
+        std::ofstream out(tmp_file_path, std::ios::trunc);
+        out << json.dump();
+        if (!out) {
+            LOG_ERROR_EX << "Unable to write resend queue file " << tmp_file_path;
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp_file_path, file_path_, ec);
+    if (ec)
+        LOG_ERROR_EX << "Unable to write resend queue file " << file_path_ << ": " << ec.message();
+}
+
+void ResendStore::SaveDebounced(Clock::time_point now) {
+    changed_ = true;
+    if (now - saved_at_ >= kSaveInterval)
+        Save();
+}
+
+std::map<uint64_t, ResendStore::Item>::iterator ResendStore::FindIdleAlarm(uint64_t user) {
+    return std::find_if(begin(items_), end(items_), [&](const auto& p) {
+        return p.second.user == user && !in_progress_.contains(p.first) && std::holds_alternative<messages::AlarmPhoto>(p.second.message);
+    });
+}
+
+void ResendStore::Supersede(Item& latest, const Item& superseded) {
+    // The latest alarm is kept, with the summary of superseded ones. Retry schedule is kept as well
+    auto& alarm = std::get<messages::AlarmPhoto>(latest.message);
+    const auto& superseded_alarm = std::get<messages::AlarmPhoto>(superseded.message);
+    alarm.superseded_alarms += superseded_alarm.superseded_alarms + 1;
+    alarm.superseded_since = superseded_alarm.superseded_since.empty() ? GetHumanDateTime(superseded_alarm.file_path.filename().generic_string())
+                                                                       : superseded_alarm.superseded_since;
+    latest.attempts = superseded.attempts;
+    latest.created = superseded.created;
+    latest.next_attempt = superseded.next_attempt;
+}
+
+void ResendStore::Coalesce(Item& item) {
+    if (!std::holds_alternative<messages::AlarmPhoto>(item.message))
+        return;
+
+    // Alarm which is being resent is merged when it's completed, see Complete()
+    const auto it = FindIdleAlarm(item.user);
+    if (it == end(items_))
+        return;
+
+    Supersede(item, it->second);
+    items_.erase(it);
+}
+
+void ResendStore::Add(uint64_t user, const Message& message) {
+    // Groups are resent as separate messages, so a single missing file doesn't block the rest
+    if (const auto group = std::get_if<messages::AlarmPhotoGroup>(&message)) {
+        for (const auto& alarm : group->alarms)
+            Add(user, alarm);
+        return;
+    }
+    if (const auto group = std::get_if<messages::PreviewGroup>(&message)) {
+        for (const auto& file_path : group->file_paths)
+            Add(user, messages::Preview{std::set<uint64_t>{user}, file_path});
+        return;
+    }
+
+    if (!IsResendable(message))
+        return;
+
+    const auto now = Clock::now();
+    std::lock_guard lock(mutex_);
+    WriteImage(message);  // Under the lock, as the photo is added for every recipient
+    Item item{next_id_++, user, message, 1, now, now + kInitialDelay};
+    std::visit([user](auto& m) {
+        if constexpr (std::is_base_of_v<messages::MultipleRecipients, std::decay_t<decltype(m)>>)
+            m.recipients = {user};
+    }, item.message);
+    Coalesce(item);
+    items_.emplace(item.id, std::move(item));
+    SaveDebounced(now);
+}
+
+std::vector<ResendStore::Item> ResendStore::GetDue(Clock::time_point now) {
+    std::lock_guard lock(mutex_);
+    std::vector<Item> result;
+    bool changed = false;
+    for (auto it = begin(items_); it != end(items_);) {
+        if (now - it->second.created > kMaxAge) {
+            LOG_WARNING << "Message to user " << it->second.user << " is not sent for too long, dropped";
+            in_progress_.erase(it->first);
+            it = items_.erase(it);
+            changed = true;
+            continue;
+        }
+        if (it->second.next_attempt <= now && !in_progress_.contains(it->first)) {
+            in_progress_.insert(it->first);
+            result.push_back(it->second);
+        }
+        ++it;
+    }
+    if (changed)
+        changed_ = true;
+    if (changed_ && now - saved_at_ >= kSaveInterval)
+        Save();  // Changes postponed by debouncing
+    return result;
+}
+
+void ResendStore::Complete(const std::vector<uint64_t>& sent_ids, const std::vector<uint64_t>& failed_ids) {
+    if (sent_ids.empty() && failed_ids.empty())
+        return;
+
+    const auto now = Clock::now();
+    std::lock_guard lock(mutex_);
+    for (const auto id : sent_ids) {
+        in_progress_.erase(id);
+        items_.erase(id);
+    }
+    for (const auto id : failed_ids) {
+        in_progress_.erase(id);
+        const auto it = items_.find(id);
+        if (it == end(items_))
+            continue;
+        auto& item = it->second;
+        const auto delay = kInitialDelay * (1LL << std::min<size_t>(item.attempts, 10));
+        item.next_attempt = now + std::min<Clock::duration>(delay, kMaxDelay);
+        ++item.attempts;
+
+        // Alarms added while this one was being resent are newer, it's collapsed into them
+        if (std::holds_alternative<messages::AlarmPhoto>(item.message)) {
+            if (const auto latest = FindIdleAlarm(item.user); latest != end(items_) && latest->first > id) {
+                Supersede(latest->second, item);
+                items_.erase(it);
+            }
+        }
+    }
+    SaveDebounced(now);
+}
+
+size_t ResendStore::Size() const {
+    std::lock_guard lock(mutex_);
+    return items_.size();
+}
+
+}  // namespace telegram
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "telegram_messages.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace telegram {
+
+// Messages failed to send, persisted to survive restart. Every recipient is retried independently, with exponential
+// backoff. Alarms superseded while sending fails are collapsed into the latest one. Changes are saved at most once per
+// a few seconds, so a burst of failures doesn't rewrite the file for every message. Only file paths of photos are
+// persisted, so photo sent from memory is written to its file when it's added. Thread safe
+class ResendStore final {
+public:
+    using Clock = std::chrono::system_clock;
+
+    struct Item {
+        uint64_t id{0};
+        uint64_t user{0};
+        Message message;  // Single recipient message
+        size_t attempts{0};
+        Clock::time_point created{};
+        Clock::time_point next_attempt{};
+    };
+
+    explicit ResendStore(std::filesystem::path file_path);
+    ~ResendStore();
+
+    ResendStore(const ResendStore&) = delete;
+    ResendStore(ResendStore&&) = delete;
+    ResendStore& operator=(const ResendStore&) = delete;
+    ResendStore& operator=(ResendStore&&) = delete;
+
+    static bool IsResendable(const Message& message);
+
+    void Add(uint64_t user, const Message& message);  // Message failed to send for the first time. Groups are split
+    std::vector<Item> GetDue(Clock::time_point now);  // Returned items are marked as in progress
+    void Complete(const std::vector<uint64_t>& sent_ids, const std::vector<uint64_t>& failed_ids);
+    size_t Size() const;
+
+private:
+    void Load();
+    void Save();
+    void SaveDebounced(Clock::time_point now);
+    void Coalesce(Item& item);
+    std::map<uint64_t, Item>::iterator FindIdleAlarm(uint64_t user);
+    static void Supersede(Item& latest, const Item& superseded);
+
+    const std::filesystem::path file_path_;
+    std::map<uint64_t, Item> items_;  // By id, i. e. in order of adding
+    std::set<uint64_t> in_progress_;
+    uint64_t next_id_{1};
+    bool changed_{false};  // Not saved yet
+    Clock::time_point saved_at_{};
+    mutable std::mutex mutex_;
+};
+
+}  // namespace telegram
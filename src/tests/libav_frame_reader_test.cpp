@@ -0,0 +1,104 @@
+// Reads a small clip written to local file, so the reader is checked without a camera
+
+#include "libav_frame_reader.h"
+
+#include "log.h"
+#include "metrics.h"
+#include "ring_buffer.h"
+#include "safe_ptr.h"
+#include "settings.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+LogLevel kAppLogLevel{LogLevel::kWarning};
+std::ostream* kAppLogStream{&std::cout};
+SafePtr<RingBuffer<std::string>> AppLogTail{32};
+SafePtr<Metrics> AppMetrics{};
+
+namespace {
+
+const int kClipFrames = 50;
+const int kClipWidth = 320;
+const int kClipHeight = 240;
+const double kClipFps = 25.0;
+const int kRetrieveInterval = 5;  // Every n-th frame is decoded, as core does for detect frames
+
+bool Check(bool condition, const std::string& description) {
+    std::cout << (condition ? "[ OK ] " : "[FAIL] ") << description << std::endl;
+    return condition;
+}
+
+// MJPG is available in every OpenCV build, and every packet of it is a frame
+bool WriteClip(const std::filesystem::path& file_path) {
+    cv::VideoWriter writer(file_path.generic_string(), cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), kClipFps, cv::Size(kClipWidth, kClipHeight));
+    if (!writer.isOpened())
+        return false;
+    for (int i = 0; i < kClipFrames; ++i) {
+        cv::Mat frame(kClipHeight, kClipWidth, CV_8UC3, cv::Scalar(i * 5 % 256, 128, 255 - i * 5 % 256));
+        cv::rectangle(frame, cv::Rect(i * 6 % kClipWidth, kClipHeight / 3, 40, 30), cv::Scalar(0, 0, 255), cv::FILLED);
+        writer.write(frame);
+    }
+    return true;
+}
+
+struct ReadResult {
+    int grabbed{0};
+    int retrieved{0};
+    bool frame_size_ok{true};
+};
+
+ReadResult ReadAll(LibavFrameReader& reader) {
+    ReadResult result;
+    cv::Mat frame;
+    while (reader.Grab()) {
+        if (result.grabbed++ % kRetrieveInterval != 0)
+            continue;
+        if (!reader.Retrieve(frame))
+            break;
+        ++result.retrieved;
+        result.frame_size_ok &= frame.cols == kClipWidth && frame.rows == kClipHeight && frame.type() == CV_8UC3;
+    }
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    const auto storage_path = std::filesystem::temp_directory_path() / "libav_frame_reader_test";
+    std::filesystem::remove_all(storage_path);
+    std::filesystem::create_directories(storage_path);
+    const auto clip_path = storage_path / "clip.avi";
+
+    bool result = Check(WriteClip(clip_path), "Clip is written");
+    if (result) {
+        LibavFrameReader reader(clip_path.generic_string(), Settings::LibavReaderSettings{});
+        int packets = 0;
+        reader.SetPacketHandler([&packets](EncodedPacket) { ++packets; });
+        result &= Check(reader.Open(), "Clip is opened");
+
+        const auto properties = reader.GetStreamProperties();
+        result &= Check(properties.width == kClipWidth && properties.height == kClipHeight, "Stream properties are obtained");
+
+        const auto first = ReadAll(reader);
+        const int expected_retrieved = (kClipFrames + kRetrieveInterval - 1) / kRetrieveInterval;
+        result &= Check(first.grabbed == kClipFrames, "All frames are grabbed");
+        result &= Check(first.retrieved == expected_retrieved, "Requested frames are retrieved");
+        result &= Check(first.frame_size_ok, "Retrieved frames have stream size");
+        result &= Check(packets == kClipFrames, "Every packet is passed to handler");
+
+        // Reader is at the end of the clip, reconnect starts it over
+        result &= Check(reader.Reconnect(), "Clip is reconnected");
+        const auto second = ReadAll(reader);
+        result &= Check(second.grabbed == kClipFrames, "All frames are grabbed after reconnect");
+        result &= Check(second.retrieved == expected_retrieved, "Requested frames are retrieved after reconnect");
+        result &= Check(second.frame_size_ok, "Retrieved frames have stream size after reconnect");
+    }
+
+    std::filesystem::remove_all(storage_path);
+    std::cout << (result ? "PASSED" : "FAILED") << std::endl;
+    return result ? 0 : 1;
+}
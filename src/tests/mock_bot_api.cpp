@@ -0,0 +1,219 @@
+#include "mock_bot_api.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace {
+
+using boost::asio::ip::tcp;
+
+const auto kSlack = std::chrono::milliseconds(100);  // Network and scheduling jitter, requests are timestamped on arrival
+
+std::string ToLower(std::string str) {
+    std::transform(begin(str), end(str), begin(str), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return str;
+}
+
+std::string ReadLine(tcp::socket& socket, boost::asio::streambuf& buffer) {
+    const auto size = boost::asio::read_until(socket, buffer, "\r\n");
+    const auto data = boost::asio::buffers_begin(buffer.data());
+    std::string line(data, data + static_cast<std::ptrdiff_t>(size - 2));
+    buffer.consume(size);
+    return line;
+}
+
+std::string Read(tcp::socket& socket, boost::asio::streambuf& buffer, size_t size) {
+    if (buffer.size() < size)
+        boost::asio::read(socket, buffer, boost::asio::transfer_exactly(size - buffer.size()));
+    const auto data = boost::asio::buffers_begin(buffer.data());
+    std::string result(data, data + static_cast<std::ptrdiff_t>(size));
+    buffer.consume(size);
+    return result;
+}
+
+int64_t ParseChatId(const std::string& body) {
+    // Multipart form, as sent by curl clients
+    static const std::string kMultipartName = "name=\"chat_id\"";
+    if (auto pos = body.find(kMultipartName); pos != std::string::npos) {
+        pos = body.find("\r\n\r\n", pos);
+        if (pos != std::string::npos)
+            return std::stoll(body.substr(pos + 4, 24));
+    }
+
+    // Url encoded form
+    static const std::string kUrlEncodedName = "chat_id=";
+    for (auto pos = body.find(kUrlEncodedName); pos != std::string::npos; pos = body.find(kUrlEncodedName, pos + 1)) {
+        if (pos == 0 || body[pos - 1] == '&')
+            return std::stoll(body.substr(pos + kUrlEncodedName.size(), 24));
+    }
+    return 0;
+}
+
+}  // namespace
+
+MockBotApi::MockBotApi()
+    : acceptor_{io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)} {
+    global_.interval = std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / 30;
+    global_.burst = global_.interval * 29;
+    accept_thread_ = std::jthread(&MockBotApi::AcceptFn, this);
+}
+
+MockBotApi::~MockBotApi() {
+    {
+        std::lock_guard lock(mutex_);
+        stopped_ = true;
+    }
+
+    // Blocking accept is woken up by connection
+    boost::system::error_code ec;
+    tcp::socket waker(io_context_);
+    waker.connect(acceptor_.local_endpoint(), ec);
+    accept_thread_.join();
+
+    for (auto& socket : sockets_)
+        socket->shutdown(tcp::socket::shutdown_both, ec);
+    sessions_.clear();  // Joined here
+}
+
+std::string MockBotApi::GetUrl() const {
+    return "http://127.0.0.1:" + std::to_string(acceptor_.local_endpoint().port());
+}
+
+void MockBotApi::InjectRateLimit(int64_t chat_id, std::chrono::seconds retry_after) {
+    std::lock_guard lock(mutex_);
+    injected_[chat_id] = retry_after;
+}
+
+std::vector<MockBotApi::Request> MockBotApi::GetRequests() const {
+    std::lock_guard lock(mutex_);
+    return requests_;
+}
+
+void MockBotApi::AcceptFn() {
+    while (true) {
+        auto socket = std::make_shared<tcp::socket>(io_context_);
+        boost::system::error_code ec;
+        acceptor_.accept(*socket, ec);
+
+        std::lock_guard lock(mutex_);
+        if (stopped_)
+            break;
+        if (ec)
+            continue;
+        sockets_.push_back(socket);
+        sessions_.emplace_back(&MockBotApi::SessionFn, this, std::move(socket));
+    }
+}
+
+void MockBotApi::SessionFn(std::shared_ptr<tcp::socket> socket) {
+    boost::asio::streambuf buffer;
+    try {
+        while (true) {
+            const auto request_line = ReadLine(*socket, buffer);
+            if (request_line.empty())
+                continue;
+
+            std::map<std::string, std::string> headers;
+            for (auto line = ReadLine(*socket, buffer); !line.empty(); line = ReadLine(*socket, buffer)) {
+                const auto colon_pos = line.find(':');
+                if (colon_pos == std::string::npos)
+                    continue;
+                const auto value_pos = line.find_first_not_of(' ', colon_pos + 1);
+                headers[ToLower(line.substr(0, colon_pos))] = ToLower(value_pos == std::string::npos ? std::string() : line.substr(value_pos));
+            }
+
+            if (headers["expect"] == "100-continue")
+                boost::asio::write(*socket, boost::asio::buffer(std::string("HTTP/1.1 100 Continue\r\n\r\n")));
+
+            std::string body;
+            if (headers["transfer-encoding"] == "chunked") {
+                for (auto size = std::stoul(ReadLine(*socket, buffer), nullptr, 16); size > 0; size = std::stoul(ReadLine(*socket, buffer), nullptr, 16)) {
+                    body += Read(*socket, buffer, size);
+                    ReadLine(*socket, buffer);  // Chunk end
+                }
+                while (!ReadLine(*socket, buffer).empty()) {}  // Trailer
+            } else if (headers.contains("content-length")) {
+                body = Read(*socket, buffer, std::stoul(headers["content-length"]));
+            }
+
+            std::string verb;
+            std::string target;
+            std::istringstream(request_line) >> verb >> target;
+
+            int http_status = 200;
+            const auto content = Handle(target, body, http_status);
+            const auto response = "HTTP/1.1 " + std::to_string(http_status) + (http_status == 200 ? " OK" : " Too Many Requests")
+                                   + "\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(content.size()) + "\r\n\r\n" + content;
+            boost::asio::write(*socket, boost::asio::buffer(response));
+        }
+    } catch (std::exception&) {
+        // Connection is closed
+    }
+}
+
+MockBotApi::Bucket& MockBotApi::GetChatBucket(int64_t chat_id) {
+    auto it = chats_.find(chat_id);
+    if (it == chats_.end()) {
+        // Negative ids are groups
+        Bucket bucket;
+        bucket.interval = chat_id < 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(3)) : std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1));
+        bucket.burst = chat_id < 0 ? bucket.interval * 19 : Clock::duration::zero();
+        it = chats_.emplace(chat_id, bucket).first;
+    }
+    return it->second;
+}
+
+std::string MockBotApi::Handle(const std::string& target, const std::string& body, int& http_status) {
+    const auto now = Clock::now();
+    const auto method = target.substr(target.rfind('/') + 1);
+    const auto chat_id = ParseChatId(body);
+
+    std::lock_guard lock(mutex_);
+    auto& chat = GetChatBucket(chat_id);
+    auto status = Status::kOk;
+    Clock::duration retry_after{};
+    if (const auto it = injected_.find(chat_id); it != injected_.end()) {
+        status = Status::kInjected;
+        retry_after = it->second;
+        injected_.erase(it);
+    } else if (now < chat.paused_till) {
+        status = Status::kRateLimited;
+        retry_after = chat.paused_till - now;
+    } else if (const auto earliest = std::max(global_.tat - global_.burst, chat.tat - chat.burst); now + kSlack < earliest) {
+        status = Status::kRateLimited;
+        retry_after = earliest - now;
+    } else {
+        global_.tat = std::max(global_.tat, now) + global_.interval;
+        chat.tat = std::max(chat.tat, now) + chat.interval;
+    }
+    requests_.push_back({now, method, chat_id, status});
+
+    if (status != Status::kOk) {
+        const auto retry_after_s = std::max<int64_t>(1, std::chrono::ceil<std::chrono::seconds>(retry_after).count());
+        chat.paused_till = std::max(chat.paused_till, now + std::chrono::seconds(retry_after_s));
+        http_status = 429;
+        return nlohmann::json{
+            {"ok", false},
+            {"error_code", 429},
+            {"description", "Too Many Requests: retry after " + std::to_string(retry_after_s)},
+            {"parameters", {{"retry_after", retry_after_s}}}
+        }.dump();
+    }
+
+    const auto message_id = requests_.size();
+    auto message = nlohmann::json{
+        {"message_id", message_id},
+        {"date", 0},
+        {"chat", {{"id", chat_id}, {"type", chat_id < 0 ? "group" : "private"}}}
+    };
+    if (method == "sendPhoto") {
+        const auto file_id = "photo_" + std::to_string(message_id);
+        message["photo"] = nlohmann::json::array({{{"file_id", file_id}, {"file_unique_id", file_id}, {"width", 1}, {"height", 1}}});
+    } else {
+        message["text"] = "ok";
+    }
+    return nlohmann::json{{"ok", true}, {"result", message}}.dump();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local Bot API server for tests. Enforces Bot API limits (30 messages per second globally, 1 per second for a private
+// chat, 20 per minute for a group) and answers 429 error with retry_after when they are exceeded
+class MockBotApi final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Status {
+        kOk,
+        kInjected,  // Rate limit error requested by test
+        kRateLimited  // Limits are exceeded, or the chat is requested before retry_after expired
+    };
+
+    struct Request {
+        Clock::time_point time;
+        std::string method;
+        int64_t chat_id{};
+        Status status{Status::kOk};
+    };
+
+    MockBotApi();  // Listens on a free local port
+    ~MockBotApi();
+
+    MockBotApi(const MockBotApi&) = delete;
+    MockBotApi(MockBotApi&&) = delete;
+    MockBotApi& operator=(const MockBotApi&) = delete;
+    MockBotApi& operator=(MockBotApi&&) = delete;
+
+    std::string GetUrl() const;
+    void InjectRateLimit(int64_t chat_id, std::chrono::seconds retry_after);  // The next request to the chat fails with 429 error
+    std::vector<Request> GetRequests() const;
+
+private:
+    struct Bucket {
+        Clock::duration interval{};
+        Clock::duration burst{};
+        Clock::time_point tat{};
+        Clock::time_point paused_till{};
+    };
+
+    void AcceptFn();
+    void SessionFn(std::shared_ptr<boost::asio::ip::tcp::socket> socket);
+    std::string Handle(const std::string& target, const std::string& body, int& http_status);
+    Bucket& GetChatBucket(int64_t chat_id);
+
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    bool stopped_{false};
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> sockets_;
+    std::vector<std::jthread> sessions_;
+    std::jthread accept_thread_;
+
+    Bucket global_;
+    std::map<int64_t, Bucket> chats_;
+    std::map<int64_t, std::chrono::seconds> injected_;
+    std::vector<Request> requests_;
+    mutable std::mutex mutex_;
+};
@@ -0,0 +1,109 @@
+// Drives MessagesSender at local mock Bot API server, which answers 429 error when Bot API limits are exceeded
+
+#include "mock_bot_api.h"
+
+#include "log.h"
+#include "metrics.h"
+#include "ring_buffer.h"
+#include "safe_ptr.h"
+#include "settings.h"
+#include "telegram_messages.h"
+#include "telegram_messages_sender.h"
+
+#include <tgbot/tgbot.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+LogLevel kAppLogLevel{LogLevel::kWarning};
+std::ostream* kAppLogStream{&std::cout};
+SafePtr<RingBuffer<std::string>> AppLogTail{32};
+SafePtr<Metrics> AppMetrics{};
+
+namespace {
+
+const std::string kToken = "123:TEST";
+const size_t kSendWorkers = 8;
+
+bool Check(bool condition, const std::string& description) {
+    std::cout << (condition ? "[ OK ] " : "[FAIL] ") << description << std::endl;
+    return condition;
+}
+
+size_t CountStatus(const std::vector<MockBotApi::Request>& requests, MockBotApi::Status status) {
+    return static_cast<size_t>(std::count_if(begin(requests), end(requests), [status](const auto& r) { return r.status == status; }));
+}
+
+// Private chats and groups are sent a few messages each, which is several times over global limit
+bool TestLoad(const std::filesystem::path& storage_path) {
+    MockBotApi mock;
+    TgBot::CurlHttpClient http_client;
+    TgBot::Bot bot(kToken, http_client, mock.GetUrl());
+    telegram::MessagesSender sender(&bot, mock.GetUrl(), storage_path, kSendWorkers, Settings::TelegramRateLimitSettings{});
+
+    telegram::messages::TextMessage message;
+    for (uint64_t user = 1001; user <= 1060; ++user)
+        message.recipients.insert(user);
+    for (const int64_t group : {-2001, -2002})
+        message.recipients.insert(static_cast<uint64_t>(group));
+
+    const size_t kMessages = 3;
+    for (size_t i = 0; i < kMessages; ++i) {
+        message.text = "Message " + std::to_string(i);
+        sender(message);
+    }
+
+    const auto requests = mock.GetRequests();
+    bool result = Check(CountStatus(requests, MockBotApi::Status::kRateLimited) == 0, "No rate limit errors under load");
+    result &= Check(CountStatus(requests, MockBotApi::Status::kOk) == kMessages * message.recipients.size(), "All messages are delivered");
+    return result;
+}
+
+// Concurrent sends to the chat, the first of them fails with 429 error. Slots reserved before the error are postponed
+bool TestBackoff(const std::filesystem::path& storage_path) {
+    const int64_t kChatId = 1001;
+    const auto kRetryAfter = std::chrono::seconds(2);
+
+    MockBotApi mock;
+    TgBot::CurlHttpClient http_client;
+    TgBot::Bot bot(kToken, http_client, mock.GetUrl());
+    {
+        telegram::MessagesSender sender(&bot, mock.GetUrl(), storage_path, kSendWorkers, Settings::TelegramRateLimitSettings{});
+        mock.InjectRateLimit(kChatId, kRetryAfter);
+
+        telegram::messages::OnDemandPhoto photo;
+        photo.recipients = {static_cast<uint64_t>(kChatId)};
+        photo.file_path = storage_path / "img_20240101T120000_000000.jpg";
+        photo.image = std::make_shared<const std::vector<unsigned char>>(1024, static_cast<unsigned char>(0xFF));
+
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < 3; ++i)
+            threads.emplace_back([&] { sender(photo); });
+    }  // Failed photo is in resend queue, which is not waited for
+
+    auto requests = mock.GetRequests();
+    std::erase_if(requests, [](const auto& r) { return r.chat_id != kChatId; });
+    bool result = Check(CountStatus(requests, MockBotApi::Status::kInjected) == 1, "Rate limit error is injected");
+    result &= Check(CountStatus(requests, MockBotApi::Status::kRateLimited) == 0, "Chat is not requested before retry_after expires");
+    result &= Check(CountStatus(requests, MockBotApi::Status::kOk) == 2, "Postponed photos are delivered");
+    if (requests.size() >= 2 && requests.front().status == MockBotApi::Status::kInjected)
+        result &= Check(requests[1].time - requests.front().time >= kRetryAfter, "Chat is requested after retry_after");
+    return result;
+}
+
+}  // namespace
+
+int main() {
+    const auto storage_path = std::filesystem::temp_directory_path() / "telegram_rate_limit_test";
+    std::filesystem::remove_all(storage_path);
+    std::filesystem::create_directories(storage_path);
+
+    bool result = TestLoad(storage_path);
+    result &= TestBackoff(storage_path);
+
+    std::filesystem::remove_all(storage_path);
+    std::cout << (result ? "PASSED" : "FAILED") << std::endl;
+    return result ? 0 : 1;
+}
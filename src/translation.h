@@ -19,6 +19,7 @@ static const std::string kPing = "\xD0\xA1\xD1\x82\xD0\xB0\xD1\x82\xD1\x83\xD1\x
 static const std::string kPause = "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xBE\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xB8\xD1\x82\xD1\x8C";
 static const std::string kResume = "\xD0\x92\xD0\xBE\xD0\xB7\xD0\xBE\xD0\xB1\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xB8\xD1\x82\xD1\x8C";
 static const std::string kLog = "\xD0\x9B\xD0\xBE\xD0\xB3";
+static const std::string kMetrics = "\xD0\x9C\xD0\xB5\xD1\x82\xD1\x80\xD0\xB8\xD0\xBA\xD0\xB8";
 #else
 static const std::string kCaption = "&#9995; Start here";
 static const std::string kViews = "Views";
@@ -30,6 +31,7 @@ static const std::string kPing = "Status";
 static const std::string kPause = "Pause";
 static const std::string kResume = "Resume";
 static const std::string kLog = "Log";
+static const std::string kMetrics = "Metrics";
 #endif
 
 }  // namespace menu
@@ -45,6 +47,8 @@ static const std::string kFileNotFound = "\xD0\xA4\xD0\xB0\xD0\xB9\xD0\xBB\x20\x
 static const std::string kAppStarted = "\xD0\xA1\xD1\x82\xD0\xB0\xD1\x80\xD1\x82\x20\xD0\xBF\xD1\x80\xD0\xB8\xD0\xBB\xD0\xBE\xD0\xB6\xD0\xB5\xD0\xBD\xD0\xB8\xD1\x8F";
 static const std::string kUptime = "\xD0\x90\xD0\xBF\xD1\x82\xD0\xB0\xD0\xB9\xD0\xBC";
 static const std::string kNotificationsPaused = "\xD0\xA3\xD0\xB2\xD0\xB5\xD0\xB4\xD0\xBE\xD0\xBC\xD0\xBB\xD0\xB5\xD0\xBD\xD0\xB8\xD1\x8F\x20\xD0\xBF\xD1\x80\xD0\xB8\xD0\xBE\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xBB\xD0\xB5\xD0\xBD\xD1\x8B\x20\xD0\xB4\xD0\xBE";
+static const std::string kArchiveDisabled = "\xD0\x9D\xD0\xB5\xD0\xBF\xD1\x80\xD0\xB5\xD1\x80\xD1\x8B\xD0\xB2\xD0\xBD\xD0\xB0\xD1\x8F\x20\xD0\xB7\xD0\xB0\xD0\xBF\xD0\xB8\xD1\x81\xD1\x8C\x20\xD0\xBE\xD1\x82\xD0\xBA\xD0\xBB\xD1\x8E\xD1\x87\xD0\xB5\xD0\xBD\xD0\xB0";
+static const std::string kMoreAlarmsSince = "\xD0\xB5\xD1\x89\xD1\x91\x20\xD1\x82\xD1\x80\xD0\xB5\xD0\xB2\xD0\xBE\xD0\xB3\x20\xD1\x81";
 static const std::string kNotificationsResumed = "\xD0\xA3\xD0\xB2\xD0\xB5\xD0\xB4\xD0\xBE\xD0\xBC\xD0\xBB\xD0\xB5\xD0\xBD\xD0\xB8\xD1\x8F\x20\xD0\xB2\xD0\xBE\xD0\xB7\xD0\xBE\xD0\xB1\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xBB\xD0\xB5\xD0\xBD\xD1\x8B";
 #else
 static const std::string kAvailable = "free";
@@ -56,6 +60,8 @@ static const std::string kAppStarted = "App started";
 static const std::string kUptime = "uptime";
 static const std::string kNotificationsPaused = "Notifications paused till";
 static const std::string kNotificationsResumed = "Resume notifications";
+static const std::string kArchiveDisabled = "Continuous recording is disabled";
+static const std::string kMoreAlarmsSince = "more alarms since";
 
 #endif
 
@@ -67,12 +73,20 @@ namespace errors {
 static const std::string kAiProcessingError = "\xD0\x9E\xD0\xB1\xD1\x80\xD0\xB0\xD0\xB1\xD0\xBE\xD1\x82\xD0\xBA\xD0\xB0\x20\x41\x49\x20\xD0\xB7\xD0\xB0\xD0\xB2\xD0\xB5\xD1\x80\xD1\x88\xD0\xB8\xD0\xBB\xD0\xB0\xD1\x81\xD1\x8C\x20\xD1\x81\x20\xD0\xBE\xD1\x88\xD0\xB8\xD0\xB1\xD0\xBA\xD0\xBE\xD0\xB9";
 static const std::string kAiProcessingRestored = "\xD0\x9E\xD0\xB1\xD1\x80\xD0\xB0\xD0\xB1\xD0\xBE\xD1\x82\xD0\xBA\xD0\xB0\x20\x41\x49\x20\xD0\xB2\xD0\xBE\xD1\x81\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xB8\xD0\xBB\xD0\xB0\x20\xD1\x80\xD0\xB0\xD0\xB1\xD0\xBE\xD1\x82\xD1\x83";
 static const std::string kGetFrameError = "\xD0\xA1\xD0\xBE\xD0\xB5\xD0\xB4\xD0\xB8\xD0\xBD\xD0\xB5\xD0\xBD\xD0\xB8\xD0\xB5\x20\xD1\x81\x20\xD0\xB8\xD1\x81\xD1\x82\xD0\xBE\xD1\x87\xD0\xBD\xD0\xB8\xD0\xBA\xD0\xBE\xD0\xBC\x20\xD0\xBA\xD0\xB0\xD0\xB4\xD1\x80\xD0\xBE\xD0\xB2\x20\xD0\xBF\xD0\xBE\xD1\x82\xD0\xB5\xD1\x80\xD1\x8F\xD0\xBD\xD0\xBE";
+static const std::string kStorageFull = "\xD0\xA5\xD1\x80\xD0\xB0\xD0\xBD\xD0\xB8\xD0\xBB\xD0\xB8\xD1\x89\xD0\xB5\x20\xD0\xBF\xD0\xB5\xD1\x80\xD0\xB5\xD0\xBF\xD0\xBE\xD0\xBB\xD0\xBD\xD0\xB5\xD0\xBD\xD0\xBE\x2C\x20\xD0\xBE\xD1\x87\xD0\xB8\xD1\x81\xD1\x82\xD0\xBA\xD0\xB0\x20\xD0\xBD\xD0\xB5\x20\xD1\x83\xD1\x81\xD0\xBF\xD0\xB5\xD0\xB2\xD0\xB0\xD0\xB5\xD1\x82";
+static const std::string kStorageRestored = "\xD0\x9E\xD1\x87\xD0\xB8\xD1\x81\xD1\x82\xD0\xBA\xD0\xB0\x20\xD1\x85\xD1\x80\xD0\xB0\xD0\xBD\xD0\xB8\xD0\xBB\xD0\xB8\xD1\x89\xD0\xB0\x20\xD0\xB2\xD0\xBE\xD1\x81\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xBB\xD0\xB5\xD0\xBD\xD0\xB0";
 static const std::string kGetFrameRestored = "\xD0\xA1\xD0\xBE\xD0\xB5\xD0\xB4\xD0\xB8\xD0\xBD\xD0\xB5\xD0\xBD\xD0\xB8\xD0\xB5\x20\xD1\x81\x20\xD0\xB8\xD1\x81\xD1\x82\xD0\xBE\xD1\x87\xD0\xBD\xD0\xB8\xD0\xBA\xD0\xBE\xD0\xBC\x20\xD0\xBA\xD0\xB0\xD0\xB4\xD1\x80\xD0\xBE\xD0\xB2\x20\xD0\xB2\xD0\xBE\xD1\x81\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xBB\xD0\xB5\xD0\xBD\xD0\xBE";
+static const std::string kDetectFrameError = "\xD0\xA1\xD0\xBE\xD0\xB5\xD0\xB4\xD0\xB8\xD0\xBD\xD0\xB5\xD0\xBD\xD0\xB8\xD0\xB5\x20\xD1\x81\x20\xD0\xBF\xD0\xBE\xD1\x82\xD0\xBE\xD0\xBA\xD0\xBE\xD0\xBC\x20\xD0\xB4\xD0\xB5\xD1\x82\xD0\xB5\xD0\xBA\xD1\x86\xD0\xB8\xD0\xB8\x20\xD0\xBF\xD0\xBE\xD1\x82\xD0\xB5\xD1\x80\xD1\x8F\xD0\xBD\xD0\xBE";
+static const std::string kDetectFrameRestored = "\xD0\xA1\xD0\xBE\xD0\xB5\xD0\xB4\xD0\xB8\xD0\xBD\xD0\xB5\xD0\xBD\xD0\xB8\xD0\xB5\x20\xD1\x81\x20\xD0\xBF\xD0\xBE\xD1\x82\xD0\xBE\xD0\xBA\xD0\xBE\xD0\xBC\x20\xD0\xB4\xD0\xB5\xD1\x82\xD0\xB5\xD0\xBA\xD1\x86\xD0\xB8\xD0\xB8\x20\xD0\xB2\xD0\xBE\xD1\x81\xD1\x81\xD1\x82\xD0\xB0\xD0\xBD\xD0\xBE\xD0\xB2\xD0\xBB\xD0\xB5\xD0\xBD\xD0\xBE";
 #else
 static const std::string kAiProcessingError = "AI processing error";
 static const std::string kAiProcessingRestored = "AI processing restored";
 static const std::string kGetFrameError = "Frame source connection lost";
 static const std::string kGetFrameRestored = "Frame source connection restored";
+static const std::string kDetectFrameError = "Detect sub-stream connection lost";
+static const std::string kDetectFrameRestored = "Detect sub-stream connection restored";
+static const std::string kStorageFull = "Storage full, cleanup can't keep up";
+static const std::string kStorageRestored = "Storage cleanup restored";
 #endif
 
 }  // namespace errors
@@ -46,6 +46,13 @@ inline std::string GetUidFromFileName(const std::string& file_name) {
     if (dot_pos == std::string::npos)
         return {};
 
+    // Video part files are named as prefix_YYYYMMDDTHHmmSS_US_partN.ext
+    static const auto part_regex = std::regex(R"(_part\d+$)");
+    std::smatch match;
+    const auto name = file_name.substr(0, dot_pos);
+    if (std::regex_search(name, match, part_regex))
+        return GetUidFromFileName(name.substr(0, static_cast<size_t>(match.position(0))) + file_name.substr(dot_pos));
+
     // Find second underscore - it's the delimeter: prefix_someotherprefix_YYYYMMDDTHHmmSS_US.ext
     int occurence = 0;
     const auto it = std::find_if(rbegin(file_name), rend(file_name), [&occurence](const auto& c) {
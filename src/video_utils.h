@@ -4,8 +4,11 @@
 
 #include <boost/regex.hpp>
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
+#include <string>
+#include <utility>
 #include <vector>
 
 constexpr int MaxFileSizeBytes = 40'000'000;
@@ -91,25 +94,31 @@ inline std::vector<std::filesystem::path> SplitVideoFile(const std::filesystem::
     return res;
 }
 
-inline std::vector<std::filesystem::path> EnumerateByMask(const std::filesystem::path& path) {
-    std::vector<std::filesystem::path> result;
-    
-    const boost::regex regex(".*" + path.filename().stem().generic_string() + R"(_part\d{1,2}\..*)");
+// Returns part files sorted by part number
+inline std::vector<std::pair<size_t, std::filesystem::path>> EnumerateByMask(const std::filesystem::path& path) {
+    std::vector<std::pair<size_t, std::filesystem::path>> result;
+
+    const boost::regex regex(".*" + path.filename().stem().generic_string() + R"(_part(\d+)\..*)");
     for (const auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
         if (!std::filesystem::is_regular_file(entry))
             continue;
 
-        if (boost::regex_match(entry.path().filename().generic_string(), regex)) {
+        boost::smatch match;
+        const auto file_name = entry.path().filename().generic_string();
+        if (boost::regex_match(file_name, match, regex)) {
             LOG_DEBUG << "Found file: " << entry.path();
-            result.push_back(entry.path());
+            result.emplace_back(std::stoul(match[1].str()), entry.path());
         }
     }
+    std::sort(begin(result), end(result));
     return result;
 }
 
-std::vector<std::filesystem::path> GetSplittedFileNames(const std::filesystem::path& file_name) {
+// Video parts are written either at write time (the main file is part 1, the rest are _part2, _part3...),
+// or by splitting of the main file (_part1, _part2... are copies of the main file content)
+inline std::vector<std::filesystem::path> GetSplittedFileNames(const std::filesystem::path& file_name) {
     LOG_DEBUG << "Checking for splitted files";
-    std::vector<std::filesystem::path> part_files = EnumerateByMask(file_name);
+    const auto part_files = EnumerateByMask(file_name);
     if (part_files.empty()) {
         if (std::filesystem::file_size(file_name) < MaxFileSizeBytes)
         {
@@ -119,5 +128,11 @@ std::vector<std::filesystem::path> GetSplittedFileNames(const std::filesystem::p
 
         return SplitVideoFile(file_name);
     }
-    return part_files;
+
+    std::vector<std::filesystem::path> result;
+    if (part_files.front().first != 1)
+        result.push_back(file_name);
+    for (const auto& part_file : part_files)
+        result.push_back(part_file.second);
+    return result;
 }
@@ -1,13 +1,20 @@
 #include "video_writer.h"
 
 #include "log.h"
+#include "metrics.h"
 #include "uid_utils.h"
 
+#include <algorithm>
 #include <string>
 
-constexpr size_t kInitialBufferSize = 120;  // Some reasonable value to fit frames without reallocate too often
 constexpr size_t kPreviewImages = 9;  // 3x3 grid. Should be square number
+constexpr size_t kPreviewImagesInRow = 3;
+constexpr size_t kPreviewRows = (kPreviewImages + kPreviewImagesInRow - 1) / kPreviewImagesInRow;
+constexpr size_t kMaxPreviewTiles = kPreviewImages * 2;  // Should be even
+constexpr int kPreviewWidth = 1920;  // TODO: Make preview size configurable
+constexpr int kPreviewTileWidth = kPreviewWidth / static_cast<int>(kPreviewImagesInRow);
 const std::string VideoWriter::kVideoFilePrefix = "v_";
+const std::string VideoWriter::kVideoPartSuffix = "_part";
 
 std::string VideoWriter::kVideoCodec = "avc1";
 std::string VideoWriter::kVideoFileExtension = ".mp4";
@@ -23,66 +30,93 @@ cv::Mat CreateEmptyPreview() {
 }  // namespace
 
 bool VideoWriter::IsVideoFile(const std::filesystem::path& file) {
-    return file.extension() == kVideoFileExtension;
+    // Part files belong to the main video file. Files with other prefixes are not event videos (e. g. continuous recording)
+    const auto stem = file.stem().generic_string();
+    return file.extension() == kVideoFileExtension && stem.starts_with(kVideoFilePrefix) && stem.find(kVideoPartSuffix) == std::string::npos;
 }
 
 std::string VideoWriter::GeneratePreviewFileName(const std::string& uid) {
     return "preview_" + uid + ".jpg";
 }
 
-std::string VideoWriter::GenerateVideoFileName(const std::string& uid) {
-    return kVideoFilePrefix + uid + kVideoFileExtension;
+std::string VideoWriter::GenerateVideoFileName(const std::string& uid, const std::string& prefix) {
+    return prefix + uid + kVideoFileExtension;
+}
+
+std::string VideoWriter::GeneratePartFileName(const std::string& uid, size_t part_number, const std::string& prefix) {
+    // The first part is the main video file, so videos without parts are handled the same way
+    if (part_number <= 1)
+        return GenerateVideoFileName(uid, prefix);
+    return prefix + uid + kVideoPartSuffix + std::to_string(part_number) + kVideoFileExtension;
 }
 
 VideoWriter::VideoWriter(const Settings& settings)
     : preview_sampling_interval_(settings.preview_sampling_interval_ms) {
     last_frame_time_ = std::chrono::steady_clock::now();
-    preview_frames_.reserve(kInitialBufferSize);
+    preview_tiles_.reserve(kMaxPreviewTiles);
 }
 
 std::string VideoWriter::GetUid() const {
     return uid_;
 }
 
+void VideoWriter::ReportStats(const std::string& writer_name, size_t frames, std::chrono::steady_clock::duration encode_time, double duration_s,
+                              size_t bytes) const {
+    const auto encode_time_s = std::chrono::duration<double>(encode_time).count();
+    const auto encode_fps = encode_time_s > 0.0 ? static_cast<double>(frames) / encode_time_s : 0.0;
+    const auto bytes_per_min = duration_s > 0.0 ? static_cast<double>(bytes) * 60.0 / duration_s : 0.0;
+    LOG_INFO << "Video writer (" << writer_name << ") finished, uid = " << uid_ << ", frames = " << frames << ", encode fps = "
+             << encode_fps << ", bytes per minute = " << bytes_per_min;
+    AppMetrics->Set("video_writer_encode_fps_" + writer_name, encode_fps);
+    AppMetrics->Set("video_writer_bytes_per_min_" + writer_name, bytes_per_min);
+}
+
 void VideoWriter::AddFrame(cv::Mat frame) {
-    if (const auto cur_time = std::chrono::steady_clock::now(); cur_time - last_frame_time_ >= preview_sampling_interval_) {
-        last_frame_time_ = cur_time;
-        preview_frames_.push_back(std::move(frame));
-        // TODO: check size to prevent mem issues
+    const auto cur_time = std::chrono::steady_clock::now();
+    if (frame.empty() || cur_time - last_frame_time_ < preview_sampling_interval_)
+        return;
+
+    last_frame_time_ = cur_time;
+    const double scale = kPreviewTileWidth / static_cast<double>(frame.cols);
+    cv::Mat tile;
+    cv::resize(frame, tile, cv::Size(kPreviewTileWidth, std::max(1, static_cast<int>(frame.rows * scale))), 0.0, 0.0, cv::INTER_AREA);
+    if (preview_canvas_.empty())
+        preview_canvas_.create(tile.rows * static_cast<int>(kPreviewRows), tile.cols * static_cast<int>(kPreviewImagesInRow), tile.type());
+    preview_tiles_.push_back(std::move(tile));
+
+    if (preview_tiles_.size() >= kMaxPreviewTiles) {
+        for (size_t i = 1; i < kMaxPreviewTiles / 2; ++i)
+            preview_tiles_[i] = std::move(preview_tiles_[i * 2]);
+        preview_tiles_.resize(kMaxPreviewTiles / 2);
+        preview_sampling_interval_ *= 2;
+        LOG_DEBUG << "Preview tiles decimated, sampling interval = " << preview_sampling_interval_.count() << " ms";
     }
 }
 
 cv::Mat VideoWriter::GetPreviewImage() const {
-    if (preview_frames_.empty()) {
+    if (preview_tiles_.empty()) {
         LOG_WARNING_EX << "Preview frames buffer is empty";
         return CreateEmptyPreview();
     }
 
-    const double step = static_cast<double>(preview_frames_.size()) / kPreviewImages;
-    LOG_INFO << "Preview frames count = " << preview_frames_.size() << ", step = " << step;
-
-    std::vector<cv::Mat> rows;
-    const auto images_in_row = static_cast<int>(std::sqrt(kPreviewImages));
-    for (size_t i = 0 ; i < kPreviewImages; ++i) {
-        const auto idx = static_cast<size_t>(step * i);
-        if (i % images_in_row == 0) {
-            LOG_DEBUG << "Add row, i = " << i;
-            rows.push_back(preview_frames_[idx]);
+    const double step = static_cast<double>(preview_tiles_.size()) / kPreviewImages;
+    LOG_INFO << "Preview tiles count = " << preview_tiles_.size() << ", step = " << step;
+
+    // Tiles are drawn into their cells of the canvas, tiles of other size (e. g. if stream is changed) are fitted
+    auto& canvas = preview_canvas_;
+    const cv::Size tile_size(canvas.cols / static_cast<int>(kPreviewImagesInRow), canvas.rows / static_cast<int>(kPreviewRows));
+    for (size_t i = 0; i < kPreviewImages; ++i) {
+        const auto& tile = preview_tiles_[static_cast<size_t>(step * i)];
+        const cv::Rect roi(static_cast<int>(i % kPreviewImagesInRow) * tile_size.width, static_cast<int>(i / kPreviewImagesInRow) * tile_size.height,
+                           tile_size.width, tile_size.height);
+        auto canvas_tile = canvas(roi);
+        if (tile.type() != canvas.type()) {
+            canvas_tile.setTo(cv::Scalar::all(0));
+        } else if (tile.size() == tile_size) {
+            tile.copyTo(canvas_tile);
         } else {
-            auto& row = rows.back();
-            cv::hconcat(row, preview_frames_[idx], row);
+            cv::resize(tile, canvas_tile, tile_size, 0.0, 0.0, cv::INTER_AREA);
         }
     }
-
-    cv::Mat& result = rows[0];
-    for (size_t i = 1; i < rows.size(); ++i) {
-        if (rows[i].cols == result.cols)
-            result.push_back(std::move(rows[i]));
-        // cv::vconcat(result, rows[i], result);
-    }
-
-    const double scale = 1920 / static_cast<float>(result.cols);  // TODO: Make preview size configurable
-    cv::Mat resized_res;
-    cv::resize(result, resized_res, cv::Size(0, 0), scale, scale, cv::INTER_AREA);
-    return resized_res;
+    return canvas;
 }
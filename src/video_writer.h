@@ -1,38 +1,64 @@
 #pragma once
+#include "encoded_packet.h"
 #include "settings.h"
 #include "stream_properties.h"
 
 #include <opencv2/opencv.hpp>
 
 #include <chrono>
+#include <filesystem>
+#include <functional>
 #include <string>
 #include <vector>
 
 class VideoWriter {
 public:
+    using PartFinishedCallback = std::function<void(const std::filesystem::path& file_path, size_t part_number)>;
+
     VideoWriter(const Settings& settings);
     virtual ~VideoWriter() = default;
 
     virtual void Start() {}
     virtual void Stop() {}
     virtual void AddFrame(cv::Mat frame);
+    virtual void AddPacket(const EncodedPacket& /*packet*/) {}
+
+    // Writers which don't encode frames themselves still get some frames to sample preview images
+    virtual bool NeedsFrames() const { return true; }
+    virtual bool NeedsPackets() const { return false; }
+
+    // Callback is called from writing thread as soon as video part file is closed, including the last one.
+    // Returns false if writer doesn't split video into parts
+    virtual bool SetPartFinishedCallback(PartFinishedCallback /*callback*/) { return false; }
 
     virtual std::string GetUid() const;
     virtual cv::Mat GetPreviewImage() const;
 
     static bool IsVideoFile(const std::filesystem::path& file);
     static std::string GeneratePreviewFileName(const std::string& uid);
-    static std::string GenerateVideoFileName(const std::string& uid);
+    static std::string GenerateVideoFileName(const std::string& uid, const std::string& prefix = kVideoFilePrefix);
+    // Part numbers start from 1
+    static std::string GeneratePartFileName(const std::string& uid, size_t part_number, const std::string& prefix = kVideoFilePrefix);
 
     static const std::string kVideoFilePrefix;
+    static const std::string kVideoPartSuffix;
     static std::string kVideoFileExtension;
     static std::string kVideoCodec;
 
 protected:
+    // Logs encoding speed and bytes per minute of video, and exports them as metrics labeled with writer name, so writers
+    // and their settings are easy to compare. Called when the file is closed
+    void ReportStats(const std::string& writer_name, size_t frames, std::chrono::steady_clock::duration encode_time, double duration_s,
+                     size_t bytes) const;
+
     std::string uid_;
 
 private:
-    const std::chrono::milliseconds preview_sampling_interval_{std::chrono::milliseconds(2000)};
+    // Preview tiles are downscaled when sampled. Number of tiles is bounded: when buffer is full, every second tile is
+    // dropped and sampling interval is doubled, so tiles stay evenly spread over the video of any length
+    std::chrono::milliseconds preview_sampling_interval_{std::chrono::milliseconds(2000)};
     std::chrono::time_point<std::chrono::steady_clock> last_frame_time_{};
-    std::vector<cv::Mat> preview_frames_;
+    std::vector<cv::Mat> preview_tiles_;
+    // Allocated for the tile grid once tile size is known, i. e. with the first tile. Tiles are drawn into it on request
+    mutable cv::Mat preview_canvas_;
 };
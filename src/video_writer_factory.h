@@ -1,18 +1,45 @@
 #pragma once
 
+#include "async_video_writer.h"
 #include "opencv_video_writer.h"
 #include "ffmpeg_video_writer.h"
 #include "settings.h"
 #include "stream_properties.h"
 #include "video_writer.h"
 
+#ifdef USE_LIBAV
+#include "libav_video_writer.h"
+#include "passthrough_video_writer.h"
+#endif
+
 #include <memory>
 #include <stdexcept>
 
-inline std::unique_ptr<VideoWriter> VideoWriterFactory(/*add type here, */const Settings& settings, const StreamProperties& in_video_properties, const StreamProperties& out_video_properties) {
-    if (settings.use_ffmpeg_writer) {
+inline std::unique_ptr<VideoWriter> CreateVideoWriter(const Settings& settings, const StreamProperties& in_video_properties, const StreamProperties& out_video_properties) {
+    switch (settings.video_writer) {
+    case VideoWriterType::kFfmpeg:
         return std::make_unique<FfmpegVideoWriter>(settings, out_video_properties);
-    } else {
+    case VideoWriterType::kPassthrough:
+#ifdef USE_LIBAV
+        return std::make_unique<PassthroughVideoWriter>(settings);
+#else
+        throw std::runtime_error("Passthrough video writer requested, but application is built without libav support");
+#endif
+    case VideoWriterType::kLibav:
+#ifdef USE_LIBAV
+        return std::make_unique<LibavVideoWriter>(settings, out_video_properties);
+#else
+        throw std::runtime_error("libav video writer requested, but application is built without libav support");
+#endif
+    case VideoWriterType::kOpenCv:
+    default:
         return std::make_unique<OpenCvVideoWriter>(settings, in_video_properties, out_video_properties);
     }
 }
+
+inline std::unique_ptr<VideoWriter> VideoWriterFactory(const Settings& settings, const StreamProperties& in_video_properties, const StreamProperties& out_video_properties) {
+    auto writer = CreateVideoWriter(settings, in_video_properties, out_video_properties);
+    if (settings.async_video_writer_settings.enabled)
+        return std::make_unique<AsyncVideoWriter>(settings, std::move(writer));
+    return writer;
+}